@@ -0,0 +1,38 @@
+#pragma once
+
+#include "GLRenderContext.hpp"
+#include "ImageRGBA.hpp"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct BandWorker;
+
+// Reads frames back from the render context a band of rows at a time, and converts
+// each band on a pool of worker threads while the next band is being read, rather
+// than reading the whole frame and then converting it all on one thread.
+//
+// Row y is always converted by worker y % Workers(). The LED panel library packs
+// rows that are a multiple of its scan height apart into the same words, so as long
+// as the worker count divides the scan height (1, 2 or 4 do for any panel), no two
+// workers ever write to the same part of a canvas.
+class BandedReadback
+{
+public:
+    typedef std::function<void(int worker, int y)> RowConverter;
+
+    // workers is rounded down to 1, 2 or 4
+    explicit BandedReadback(int workers);
+    ~BandedReadback();
+
+    int Workers() const;
+
+    // Read the oldest finished frame into frame, bandRows at a time (0 for all at once),
+    // calling convertRow for every row of it on the workers. Returns once every row has
+    // been converted, or false if there was no frame to read.
+    bool Read(GLRenderContext& render, ImageRGBA& frame, int bandRows, const RowConverter& convertRow);
+
+private:
+    std::vector<std::unique_ptr<BandWorker>> workers_;
+};
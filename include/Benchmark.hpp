@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "GLRenderContext.hpp"
+#include "DisplayDevice.hpp"
+
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Headless benchmark (mantlemap --bench [frames]).
+// Shows each base scene in turn, with the visible overlays on top, and runs it
+// for a fixed number of frames on the calling thread at a frozen scene time.
+// Frames are handed to a display, normally the null one, which reads them back
+// and drops them. That runs anywhere the render context can be created (e.g. ANGLE on a PC).
+class Benchmark
+{
+public:
+    Benchmark(const std::vector<Scene*>& baseScenes, const std::vector<Scene*>& overlayScenes, GLRenderContext& render, DisplayDevice& display);
+
+    // Run every base scene for the given number of frames and return the
+    // per-scene update, draw and readback timing percentiles in microseconds
+    // Also times reading back and converting frames in each of a few band sizes,
+    // and handing whole frames to a present thread to convert instead, and checks
+    // that frames still come out after a deep sleep
+    nlohmann::json Run(int frames);
+
+private:
+    nlohmann::json runBandSweep(int frames);
+    nlohmann::json runDeepSleep();
+
+    const std::vector<Scene*>& baseScenes_;
+    const std::vector<Scene*>& overlayScenes_;
+    GLRenderContext& render_;
+    DisplayDevice& display_;
+};
@@ -2,6 +2,7 @@
 
 #include "Scene.hpp"
 #include "TextLabel.hpp"
+#include "SnapshotBuffer.hpp"
 
 class CmdDebugScene : public Scene
 {
@@ -15,11 +16,22 @@ class CmdDebugScene : public Scene
     
 protected:
     void initGLOverride() override;
+    void releaseGLOverride() override;
     void updateOverride() override;
     void drawOverride() override;
     
 private:
     TextLabel _cmdLabel;
+
+    // Where the command is scrolled to as of the last update, published for the render thread
+    struct RenderState
+    {
+      bool showing;
+      int showPos;
+    };
+    SnapshotBuffer<RenderState> _renderState;
+
+    // Only touched on the update thread, or with the scenes locked
     int _cmdShowCounter;
     int _framesToHoldCmd;
     int _framesToScrollCmd;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "WakeSignal.hpp"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+
+// A multi-producer, single-consumer queue of commands that need to run on
+// a particular thread (generally the render loop). Producers such as HTTP
+// handlers and input threads never block or take a lock; the consumer runs
+// everything that has been posted in one go with Drain().
+class CommandQueue
+{
+public:
+    CommandQueue();
+    ~CommandQueue();
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue(CommandQueue&&) = delete;
+
+    // Queue a command to be run by the consumer. Safe to call from any thread.
+    void Post(std::function<void()> command);
+
+    // Notify this signal whenever a command is posted, so the consumer
+    // can sleep on it instead of polling. Pass nullptr to stop.
+    void SetWakeSignal(WakeSignal* wakeSignal);
+
+    // Queue a command and get a future that resolves to its return value
+    // (or rethrows whatever it threw) once the consumer has run it
+    template <typename F>
+    auto Invoke(F&& command) -> std::future<decltype(command())>
+    {
+        using Result = decltype(command());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(command));
+        auto future = task->get_future();
+        Post([task]() { (*task)(); });
+        return future;
+    }
+
+    // Run all queued commands in the order they were posted.
+    // Must only be called from the consumer thread. Returns how many ran.
+    int Drain();
+
+    // True if nothing is waiting to run. Only meaningful on the consumer thread,
+    // where it lets callers skip any setup they'd otherwise do around Drain().
+    bool Empty() const;
+
+private:
+    struct Node
+    {
+        std::atomic<Node*> next{nullptr};
+        std::function<void()> command;
+    };
+
+    // Producers swap themselves in at the head, the consumer pops from the tail
+    std::atomic<Node*> head_;
+    Node* tail_;
+
+    std::atomic<WakeSignal*> wakeSignal_;
+};
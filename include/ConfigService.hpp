@@ -56,7 +56,10 @@ class ConfigService
     bool HasKey(const std::string& key);
     bool ValueTypeMatches(const std::string& key, const nlohmann::json& value);
     const nlohmann::json& GetConfigJson(const std::string& key = "") const;
-    void Subscribe(const std::function <void (const ConfigUpdateEventArg&)>& handler);
+    // Calls handler now with every setting, then again whenever one changes. Anything that
+    // can go away before the process does keeps the connection in a sigslot::scoped_connection,
+    // so its handler is dropped along with it.
+    sigslot::connection Subscribe(const std::function <void (const ConfigUpdateEventArg&)>& handler);
 
     // Configuration functions
     template <typename T>
@@ -13,6 +13,7 @@ class DebugTransformScene : public Scene
 
 protected:
     void initGLOverride() override;
+    void releaseGLOverride() override;
     void drawOverride() override;
     
 private:
@@ -1,38 +1,99 @@
 #pragma once
 
 #include "InputButton.hpp"
+#include "FrameBus.hpp"
 
 #include <memory>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
 #include <sigslot/signal.hpp>
 
+class GLRenderContext;
+class ImageRGBA;
+struct DisplayBackend;
+struct DisplayOutput;
+
 // Display device is an abstraction that allows our framebuffer to be drawn to
 // an array of LED panels, a window on a PC, or any other image output
 
 class DisplayDevice final
 {
     public:
-        // Display devices must be constructed in the main thread
-        DisplayDevice();
+        // Display devices must be constructed in the main thread.
+        // backend is "led" (Pi builds), "window" (PC builds), "shm" (publishes frames
+        // to a shared memory ring), "record" (records frames to a file, then passes
+        // them on to the display named by the recording.display config),
+        // "net" (streams tiles of each frame to thin clients, see NetFrameStream.hpp),
+        // "null" (reads frames back and discards them)
+        // or "auto" for whichever real display this build has.
+        // Displays that can draw frames straight from render's textures (the simulator
+        // window) share its GL context when it's given; it must outlive the display.
+        // Every frame is also published on Frames(). Any CPU backends ("shm", "record", "net",
+        // "null", or "led" when it isn't the main one) listed in the displayOutputs
+        // config are driven from there too, each on its own thread.
+        // Throws if a backend isn't available in this build.
+        explicit DisplayDevice(const std::string& backend = "auto", GLRenderContext* render = nullptr);
 
         ~DisplayDevice();
 
-        // Use glReadPixels to get the rendered image and display it
-        // May wait for some kind of framebuffer sync
-        void Update(); 
+        // Read the oldest finished frame back from the render context and display it
+        // May wait for some kind of framebuffer sync, or hand the frame to
+        // a present thread when the render pipeline is deeper than one frame
+        // Frames identical to the last one shown are not sent to the display
+        void Update(GLRenderContext& render);
+
+        // Display a frame that's already on the CPU, e.g. one replayed from a recording.
+        // It must be the configured width and height.
+        void Update(const ImageRGBA& frame);
 
         // Clear the display and if possible, enter a low power state
         void Clear();
 
+        // Release the display hardware entirely (e.g. stop the LED panel's refresh
+        // thread) until Resume is called. Update and Clear do nothing until then.
+        // Extra outputs are suspended and resumed along with the main display.
+        void Suspend();
+        void Resume();
+
+        // Handle display events (input, window close, etc) without presenting a frame.
+        // Call this regularly when no new frames are being rendered.
+        void ProcessEvents();
+
+        // True if ProcessEvents needs to be called periodically even while idle,
+        // i.e. the display's events can't wake the main loop by themselves
+        bool NeedsEventPolling();
+
         // Gets an input button, if any, provided by the display
         // Pointer should be good for the display's lifetime
         // Returns nullptr if there is no button
         InputButton* GetInputButton();
 
+        // How many frames were skipped because they matched the frame already on the display
+        uint64_t GetSuppressedFrameCount();
+
+        // How many rows of the last frame actually had to be sent to the display.
+        // The LED panel skips rows that already match what its canvas holds.
+        int GetLastFrameRowsWritten();
+
+        // Which backend was picked, e.g. "led"
+        const std::string& GetBackendName();
+
         // Sometimes the display disconnects from the system. When this
         // happens we should probably exit right away
         sigslot::signal<> OnDisconnect;
 
+        // Each frame as it's displayed, duplicates included, and a black frame whenever
+        // the display is cleared. Displays that don't need frames on the CPU themselves
+        // only read them back while some subscriber wants them.
+        FrameBus& Frames();
+
     private:
-        struct Impl;
-        std::unique_ptr<Impl> pImpl_;
+        std::string backendName_;
+        FrameBus frames_;
+        std::unique_ptr<DisplayBackend> pImpl_;
+
+        // Destroyed first, so their threads are gone before the bus and backend are
+        std::vector<std::unique_ptr<DisplayOutput>> outputs_;
 };
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ImageRGBA.hpp"
+#include "TimeService.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A finished frame, shared by every subscriber that got it. Nobody may modify it.
+// The buffer goes back to the bus's pool once the last holder lets go.
+typedef std::shared_ptr<const ImageRGBA> SharedFrame;
+
+// What a subscriber's queue does with a new frame when it's already full
+enum class FrameDropPolicy
+{
+    DropOldest,   // Throw away the oldest queued frame, for outputs that want to stay live
+    DropNewest,   // Turn the new frame away, for outputs that would rather finish a burst in order
+};
+
+struct FrameSubscriberOptions
+{
+    int queueDepth = 1;
+    FrameDropPolicy dropPolicy = FrameDropPolicy::DropOldest;
+};
+
+class FrameBus;
+struct FrameBusPool;
+struct FrameSubscriber;
+
+// One subscriber's place on the bus. Its thread stops, and frames still queued
+// for it are dropped, when this is destroyed. It must not outlive the bus.
+class FrameSubscription
+{
+public:
+    ~FrameSubscription();
+
+    uint64_t FramesDelivered() const;
+    uint64_t FramesDropped() const;
+
+private:
+    friend class FrameBus;
+    FrameSubscription(FrameBus& bus, std::shared_ptr<FrameSubscriber> subscriber);
+
+    FrameBus& bus_;
+    std::shared_ptr<FrameSubscriber> subscriber_;
+};
+
+// Fans each finished frame out to any number of outputs (preview, recorder, extra
+// displays) without any of them holding up the display the frame came from.
+//
+// The publisher copies a frame into a pooled buffer once, however many subscribers
+// there are, and queues a reference to it for each. Every subscriber has its own
+// thread, queue depth and drop policy, so a slow one only ever loses its own frames.
+// Publishing never waits on a subscriber.
+//
+// A subscriber's queue depth and drop policy can be overridden from the config, under
+// frameBus.<name>.queueDepth and frameBus.<name>.dropPolicy ("oldest" or "newest").
+// Each one reports its handler time as the frameBus.<name> metrics phase, and the
+// frameBus.<name>.delivered and frameBus.<name>.dropped counters.
+class FrameBus
+{
+public:
+    typedef std::function<void(const SharedFrame& frame, FrameTimePoint time)> Handler;
+
+    FrameBus(int width, int height);
+    ~FrameBus();
+
+    // Call handler on a new thread with each published frame.
+    // wanted, if given, is asked on the publishing thread before each frame is queued
+    // for this subscriber, so it must be quick and thread safe. Unset means always.
+    std::unique_ptr<FrameSubscription> Subscribe(const std::string& name, FrameSubscriberOptions options,
+                                                 Handler handler, std::function<bool()> wanted = nullptr);
+
+    // True if any subscriber wants the next frame. Publishers that would have to
+    // read a frame back just for the bus can skip it when this is false.
+    bool Wanted();
+
+    // Copy frame into a pooled buffer and queue it for every subscriber that wants it.
+    // Does nothing, not even the copy, if nobody does.
+    void Publish(const ImageRGBA& frame, FrameTimePoint time = FrameClock::now());
+
+    // Publish a black frame, e.g. because the display was cleared
+    void PublishBlank(FrameTimePoint time = FrameClock::now());
+
+    // Ask the publisher for a frame even though nothing on the display has changed,
+    // e.g. because a subscriber just started wanting frames and the display is static.
+    // The request handler is set by whoever drives the publisher, and must be quick
+    // and thread safe. Does nothing if there isn't one.
+    void SetFrameRequestHandler(std::function<void()> handler);
+    void RequestFrame();
+
+private:
+    friend class FrameSubscription;
+    void unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber);
+    void publish(const SharedFrame& frame, FrameTimePoint time, const std::vector<std::shared_ptr<FrameSubscriber>>& targets);
+    std::vector<std::shared_ptr<FrameSubscriber>> wantedSubscribers();
+    std::shared_ptr<ImageRGBA> newFrame();
+
+    int width_;
+    int height_;
+    std::shared_ptr<FrameBusPool> pool_;
+
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<FrameSubscriber>> subscribers_;
+    std::function<void()> frameRequestHandler_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <nlohmann/json.hpp>
+
+// Steps the frame rate and scene quality down when the Pi is running hot or missing
+// frames, and back up once it has recovered, so a throttling Pi runs at a steady
+// lower rate rather than an erratic full one. Configured under governor:
+//   enabled          off unless set
+//   intervalSeconds  how often to sample
+//   thermalPath      temperature in millidegrees C (/sys/class/thermal/thermal_zone0/temp)
+//   cpuFreqPath      current CPU frequency in kHz (scaling_cur_freq)
+//   cpuMaxFreqPath   the most the CPU can run at in kHz (cpuinfo_max_freq)
+//   hotCelsius       step down at or above this
+//   coolCelsius      only step back up at or below this
+//   throttledRatio   the CPU is throttled below this fraction of its max frequency
+//   stepDownSamples  samples in a row with frames over budget before stepping down
+//   stepUpSamples    samples in a row with room to spare before stepping back up
+//   headroomRatio    how much of the faster level's frame budget counts as room to spare
+//   fpsScales        fpsLimit multiplier for each level, starting with the full rate
+//   qualityScales    scene quality for each level (see QualityScale)
+// Frame times come from the render.frame metric. Being hot steps down straight away,
+// as do frames over budget while the CPU is throttled, since that's not going to pass.
+// The sysfs paths can point at ordinary files to try it out anywhere, and any that
+// can't be read are left out. Levels are never saved: fpsLimit keeps its configured
+// value and every run starts at the full rate. Settings apply as soon as they change.
+//
+// Sampling happens in Poll, which only runs while frames are being drawn. Nothing is
+// sampled while the display is static or asleep, which is when the Pi is cooling off
+// anyway, so a hot Pi stays at its lower level until drawing starts again.
+class FrameGovernor
+{
+public:
+    FrameGovernor() = delete;
+
+    // Read the governor config and follow changes to it. Call on the main thread
+    // before SetFrameRate.
+    static void Init();
+
+    // The configured frame rate, which the current level's scale is applied to.
+    // Sets the target frame rate (see TimeService::SetTargetFrameRate).
+    static void SetFrameRate(double fps);
+
+    // Sample and change level if it's time to. Call on the main thread after each frame.
+    static void Poll();
+
+    // How much detail scenes should draw at, from 1 for full down to the lowest level's
+    // qualityScales entry, e.g. the fraction of particles simulated. Safe on any thread.
+    static float QualityScale();
+
+    // The current level and the last sample that went into it
+    static nlohmann::json Report();
+};
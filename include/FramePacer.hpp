@@ -0,0 +1,55 @@
+#pragma once
+
+#include "TimeService.hpp"
+
+#include <cstdint>
+
+// Paces a loop against absolute deadlines (start + N * period) so that
+// sleep overshoot and frame time jitter never accumulate into drift.
+// Waits sleep for the bulk of the interval and spin for the last
+// fraction of a millisecond to land accurately on the deadline.
+class FramePacer
+{
+public:
+    FramePacer();
+
+    // Set the target rate. Restarts the schedule from now.
+    void SetTargetFrameRate(double fps);
+
+    void SetOverrunPolicy(FrameOverrunPolicy policy);
+
+    // How long before a deadline to stop sleeping and start spinning
+    void SetSpinThreshold(FrameDuration threshold);
+
+    // How far behind CatchUp may fall before it gives up and realigns
+    void SetMaxCatchUpFrames(int frames);
+
+    FrameDuration GetTargetFrameDelta() const;
+
+    // Measured time between the starts of the last two frames
+    FrameDuration GetLastFrameDelta() const;
+
+    // Number of frame slots dropped because a frame overran
+    uint64_t GetSkippedFrameCount() const;
+
+    // Mark the current frame finished and wait for the next deadline
+    void FinishAndWaitForNextFrame();
+
+    // Hybrid sleep + spin until an absolute time
+    void WaitUntil(FrameTimePoint deadline) const;
+
+    // Forget the schedule, e.g. after the loop was idle for a long time.
+    // The next frame is measured as exactly one target delta long.
+    void Reset();
+
+private:
+    FrameDuration targetDelta_;
+    FrameDuration lastDelta_;
+    FrameDuration spinThreshold_;
+    FrameOverrunPolicy overrunPolicy_;
+    int maxCatchUpFrames_;
+    uint64_t skippedFrames_;
+    bool scheduleValid_;
+    FrameTimePoint nextDeadline_;
+    FrameTimePoint frameStart_;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "ImageRGBA.hpp"
+#include "TimeService.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Recordings of the rendered frame stream, for replaying into a display without
+// running any scenes (see mantlemap --replay).
+//
+// File layout (little endian):
+//   "MMRC", version, width, height, keyframe interval      (5 x uint32)
+//   then per frame: type (uint8, 0 = keyframe, 1 = delta),
+//                   timestamp in ns since the first frame (int64),
+//                   payload size (uint32), payload
+//
+// A payload is one entry per row, XORed against the same row of the previous frame
+// (or against black for keyframes), so unchanged bytes come out as zero:
+//   0                       the row is unchanged
+//   1, then runs of         (zero count, literal count, literal bytes) until the row is full,
+//                           with both counts as LEB128 varints
+// Keyframes come every so often so a damaged or truncated file still replays from the next one.
+
+// Append a payload for frame, XORed against previous, to payload. Both are width x height RGBA.
+// Pass a black previous frame for a keyframe.
+void EncodeFramePayload(const uint8_t* frame, const uint8_t* previous, int width, int height, std::vector<uint8_t>& payload);
+
+// Apply a payload to current, the frame it was encoded against, in place. Throws if it's corrupt.
+void DecodeFramePayload(const uint8_t* payload, size_t size, uint8_t* current, int width, int height);
+
+// Writes a recording, one frame at a time
+class FrameRecorder
+{
+public:
+    // Throws if the file can't be created
+    FrameRecorder(const std::string& path, int width, int height, int keyframeInterval);
+    ~FrameRecorder();
+
+    void Write(const ImageRGBA& frame, FrameTimePoint time);
+
+    uint64_t FramesWritten() const;
+    uint64_t BytesWritten() const;
+
+private:
+    std::ofstream file_;
+    int width_;
+    int height_;
+    int keyframeInterval_;
+    std::vector<uint8_t> previous_;
+    std::vector<uint8_t> payload_;
+    FrameTimePoint firstFrameTime_;
+    uint64_t framesWritten_;
+    uint64_t bytesWritten_;
+};
+
+// Reads a recording back, one frame at a time
+class FrameReplayer
+{
+public:
+    // Throws if the file can't be opened or isn't a recording
+    explicit FrameReplayer(const std::string& path);
+
+    int Width() const;
+    int Height() const;
+
+    // Decode the next frame into frame, which must match the recording's size.
+    // Returns false at the end of the recording. Throws if the file is corrupt.
+    bool Next(ImageRGBA& frame, int64_t& timestampNs);
+
+    // Go back to the first frame
+    void Rewind();
+
+private:
+    std::ifstream file_;
+    std::streampos firstFrame_;
+    int width_;
+    int height_;
+    std::vector<uint8_t> current_;
+    std::vector<uint8_t> payload_;
+    bool haveKeyframe_;
+};
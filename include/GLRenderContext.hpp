@@ -3,23 +3,140 @@
 #include "EGL/egl.h"
 #include "EGL/eglplatform.h"
 #include "GLES2/gl2.h"
+#include "GLES3/gl3.h"
 #include "EGL/eglext.h"
 
+#include "ImageRGBA.hpp"
+
+#include <sigslot/signal.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class GfxProgram;
+class GfxTexture;
+
+// renderPipelineDepth. Each frame past the first adds a frame of latency, so it's opt in.
+static constexpr int DEFAULT_PIPELINE_DEPTH = 1;
+static constexpr int MAX_PIPELINE_DEPTH = 3;
+
+// How finished frames get from the GPU to the CPU
+enum class ReadbackMode
+{
+  Framebuffer,  // glReadPixels straight out of the oldest framebuffer in the pipeline (GLES2)
+  PixelBuffer   // glReadPixels into a pixel buffer object as each frame ends, mapped once its fence signals (GLES3).
+                // Only done while something is calling ReadFrame, and with a pipeline depth above 1,
+                // since otherwise the frame read back is the one just drawn and there's nothing to overlap.
+};
+
 class GLRenderContext
 {
  public:
     GLRenderContext();
     ~GLRenderContext();
     
-    // Draw the specified scene to the RGB matrix
+    // Bind the next framebuffer in the pipeline and get ready to draw a frame
     void BeginDraw();
 
+    // Submit the frame that was just drawn and bind the oldest frame in the
+    // pipeline for reading. With a depth of 1 that's the frame just drawn, with
+    // a depth of N the GPU gets N-1 more frames to finish it before it's read back.
+    void EndDraw();
+
+    // Number of framebuffers frames rotate through between draw and readback
+    int GetPipelineDepth();
+
+    // The depth a renderPipelineDepth setting actually gets
+    static int ClampPipelineDepth(int requested);
+
+    // Copy the oldest frame in the pipeline into frame, which must be the size of the display.
+    // Call between EndDraw and the next BeginDraw. Returns false if there's no frame to read.
+    bool ReadFrame(ImageRGBA& frame);
+
+    // Like ReadFrame, but bandRows rows at a time, calling onBand(firstRow, rows) on this
+    // thread as each band lands in frame so it can be worked on while the next one is read
+    bool ReadFrameBands(ImageRGBA& frame, int bandRows, const std::function<void(int firstRow, int rows)>& onBand);
+
+    // Like ReadFrame, but gather each pixel of frame from the oldest frame through a lookup
+    // image of the same size (see PanelLayout::BuildLookup), e.g. to put it in the LED panels'
+    // native order. frame can be a different size from the display. The lookup is uploaded
+    // the first time it's seen, so keep the same one around while its contents stay the same.
+    bool ReadFrameRemapped(const ImageRGBA& lookup, ImageRGBA& frame);
+
+    // How frames are being read back at the current pipeline depth
+    ReadbackMode GetReadbackMode();
+
+    // For displays that draw frames straight from the GPU instead of reading them back.
+    // GetFrameTexture waits for the GPU to finish the oldest frame in the pipeline and
+    // returns the texture holding it, or 0 if there's no frame. Sample it from a context
+    // created to share with GetEGLContext(), binding it again after each call so the
+    // new contents show up there. Call between EndDraw and the next BeginDraw.
+    GLuint GetFrameTexture();
+    EGLDisplay GetEGLDisplay();
+    EGLContext GetEGLContext();
+    int GetGLESVersion();
+
+    // Make the render context current on this thread, e.g. to free GL resources
+    void MakeCurrent();
+
+    // Free the framebuffers, and optionally the whole EGL context, while nothing
+    // is being drawn. Everything else using GL must be released first.
+    void Suspend(bool releaseContext);
+
+    // Bring back whatever Suspend released
+    void Resume();
+
   private:
     void initGL();
+    void createFramebuffers(int count);
+    void destroyFramebuffers();
+    void createPostProcess();
+    void destroyPostProcess();
+    void updatePostProcessLut();
+    void postProcessFrame();
+    void createRemap(int width, int height);
+    void destroyRemap();
     
     EGLDisplay GDisplay;
     EGLContext GContext;
     EGLSurface GSurface;
-    GLuint FramebufferName;
-    GLuint RenderedTexture;
+    std::vector<GLuint> Framebuffers;
+    std::vector<GLuint> RenderedTextures;
+    std::vector<GLuint> PixelBuffers;
+    std::vector<GLsync> Fences;
+    std::vector<bool> PixelBufferCopied;    // Whether EndDraw queued a copy into each pixel buffer
+    bool frameReadSinceEndDraw;
+    ReadbackMode readbackMode;
+    int glesVersion;
+    int pipelineDepth;
+    int requestedPipelineDepth;
+    int drawIndex;
+    bool contextReleased;
+
+    // Optional last pass over each frame: scenes draw into SceneFramebuffer, then a
+    // fullscreen pass applies gamma / white balance and dithers down to the panel's
+    // bit depth on its way into the pipeline's framebuffer
+    bool postProcess;
+    bool postProcessDither;
+    bool postProcessLutDirty;
+    double postProcessGamma;
+    double whiteBalanceRed;
+    double whiteBalanceGreen;
+    double whiteBalanceBlue;
+    int pwmBits;
+    GLuint SceneFramebuffer;
+    std::unique_ptr<GfxTexture> SceneTexture;
+    std::unique_ptr<GfxTexture> PostProcessLut;
+    std::unique_ptr<GfxProgram> PostProcessProgram;
+    std::vector<float> PostProcessMesh;
+
+    // For ReadFrameRemapped
+    GLuint RemapFramebuffer;
+    std::unique_ptr<GfxTexture> RemapTexture;
+    std::unique_ptr<GfxTexture> RemapLookup;
+    std::unique_ptr<GfxProgram> RemapProgram;
+    const ImageRGBA* remapLookupSource;
+
+    // Last, so config changes stop reaching this before anything else is torn down
+    sigslot::scoped_connection settingsConnection;
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "CommandQueue.hpp"
+
 #include <httplib.h>
 #include <vector>
 #include <unordered_map>
@@ -7,6 +9,13 @@
 #include <thread>
 #include <condition_variable>
 
+// The outcome of a command run on the main thread for an HTTP request
+struct HttpResult
+{
+    int status = 200;
+    std::string body;
+};
+
 class HttpService
 {
 public:
@@ -15,10 +24,22 @@ public:
     bool Running();
     std::string ListeningInterface();
     httplib::Server& Server();
+
+    // Commands posted here are run by the main loop at the top of each frame.
+    // Handlers run on httplib worker threads, so anything that touches scenes,
+    // settings, or other render state must go through this queue.
+    CommandQueue& Commands();
+
+    // Run a command on the main thread, wait for it, and copy its result into res.
+    // The command must not capture anything by reference from the handler, since
+    // it may still run after we've given up waiting on it.
+    void RunOnMainThread(std::function<HttpResult()> command, httplib::Response& res);
+
 private:
     std::string listeningInterface;
     void setupCallbacks();
     std::unique_ptr<httplib::Server> srv;
     std::unique_ptr<std::thread> serverThread;
     std::unordered_map<std::string, std::string> web;
+    CommandQueue commands;
 };
\ No newline at end of file
@@ -18,6 +18,8 @@ public:
     void PadToPowerOfTwo();
     static std::shared_ptr<ImageRGBA> FromPngFile(const std::string& imagePath);
     static std::shared_ptr<ImageRGBA> FromQrPayload(const std::string& qrPayload);
+    // Encode as an opaque RGB PNG (alpha is dropped). compressionLevel is zlib's, 0-9.
+    std::vector<uint8_t> ToPng(int compressionLevel = 1) const;
     uint8_t& operator[](std::size_t idx);
 private:
     void read_png_file(const char* file_name);
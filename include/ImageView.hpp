@@ -16,6 +16,7 @@ class ImageView : public SceneElement
     void SetScale(float scale);
     int GetWidth();
     int GetHeight();
+    virtual void ReleaseGL() override;
 protected:
     virtual void initGL() override;
     virtual void drawInternal() override;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Scene.hpp"
+#include "SnapshotBuffer.hpp"
 #include "AstronomyService.hpp"
 
 class LightScene : public Scene
@@ -13,11 +14,25 @@ class LightScene : public Scene
 
 protected:
     void initGLOverride() override;
+    void releaseGLOverride() override;
     void resetOverride(bool animate) override;
     void updateOverride() override;
     void drawOverride() override;
     
 private:
+    // Everything drawOverride needs, published by the update thread
+    struct RenderState
+    {
+        double sunLat;
+        double sunLon;
+        float sunPropAngle;
+        float lightBoost;
+        double moonLat;
+        double moonLon;
+    };
+    SnapshotBuffer<RenderState> renderState;
+    void publishRenderState(bool blend = true);
+
     std::unique_ptr<GfxProgram> program;
     std::unique_ptr<GfxTexture> mapLayer1Texture;
     std::unique_ptr<GfxTexture> mapLayer2Texture;
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "TimeService.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Timing samples for one named phase of the frame (e.g. "display.readPixels").
+// Recording is lock free and cheap enough to leave on everywhere, on any thread.
+class MetricsPhase
+{
+public:
+    // Histogram bucket upper bounds in microseconds. Anything slower lands in a final overflow bucket.
+    static constexpr std::array<uint32_t, 12> BUCKET_BOUNDS_US = { 50, 100, 250, 500, 1000, 2000, 4000, 8000, 16000, 33000, 66000, 250000 };
+    static constexpr size_t BUCKET_COUNT = BUCKET_BOUNDS_US.size() + 1;
+
+    // How many of the most recent samples are kept for percentiles
+    static constexpr size_t RING_SIZE = 256;
+
+    explicit MetricsPhase(const std::string& name);
+
+    const std::string& Name() const;
+
+    void Record(FrameDuration duration);
+
+    // A copy of everything recorded so far. Samples recorded while this is being
+    // read may or may not be included, but every field is individually consistent.
+    struct Summary
+    {
+        uint64_t count;
+        double totalMicroseconds;
+        double maxMicroseconds;
+        std::array<uint64_t, BUCKET_COUNT> buckets;
+        std::vector<uint32_t> recentMicroseconds;
+    };
+    Summary Read() const;
+
+private:
+    std::string name_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> totalNanoseconds_;
+    std::atomic<uint64_t> maxNanoseconds_;
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_;
+    std::array<std::atomic<uint32_t>, RING_SIZE> recent_;
+};
+
+// Records the time between its construction and destruction to a phase
+class MetricsTimer
+{
+public:
+    explicit MetricsTimer(MetricsPhase& phase);
+    ~MetricsTimer();
+
+    MetricsTimer(const MetricsTimer&) = delete;
+    MetricsTimer& operator=(const MetricsTimer&) = delete;
+
+private:
+    MetricsPhase& phase_;
+    FrameTimePoint start_;
+};
+
+class MetricsService
+{
+public:
+    MetricsService() = delete;
+
+    // Get the phase with this name, creating it the first time it's asked for.
+    // The reference is good for the life of the program, so look it up once and
+    // keep it around rather than paying for the lookup on every frame.
+    static MetricsPhase& Phase(const std::string& name);
+
+    // A running total, e.g. of rows sent to the panel. Same lookup rules as Phase.
+    static std::atomic<uint64_t>& Counter(const std::string& name);
+
+    // Every phase's count, mean, max, recent percentiles and histogram, in microseconds,
+    // and the value of every counter
+    static nlohmann::json ToJson();
+
+    // The same histograms and counters in the Prometheus text exposition format, in seconds
+    static std::string ToPrometheus();
+};
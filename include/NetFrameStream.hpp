@@ -0,0 +1,131 @@
+#pragma once
+
+#include "ImageRGBA.hpp"
+#include "TimeService.hpp"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Streams frames, or tiles cut out of them, to other MantleMap instances over UDP.
+// One instance renders a whole wall with the "net" display and each thin client
+// (mantlemap --net-client) just shows the tile it's sent on its own panels.
+//
+// Packet layout (little endian), at most NET_FRAME_MAX_PACKET bytes:
+//   "MMNF", sequence (uint32), type (uint8, 0 = keyframe, 1 = delta), reserved (uint8),
+//   fragment index (uint16), fragment count (uint16), width (uint16), height (uint16),
+//   then that fragment of the frame's payload
+// Payloads are the same row deltas recordings use (see FrameRecording.hpp). A frame's
+// payload is split over as many packets as it takes. Deltas are against the frame with
+// the previous sequence number, so a client that misses any part of a frame shows
+// nothing new until the next keyframe, which comes every so many frames and at least
+// once a second even if nothing's changing or being rendered (see SendKeyframeIfDue).
+
+static constexpr size_t NET_FRAME_MAX_PACKET = 1400;    // Stays under a typical Ethernet MTU
+static constexpr int DEFAULT_NET_FRAME_PORT = 5005;
+
+// The part of the rendered frame one client shows, and where to send it
+struct NetFrameTile
+{
+    std::string address;
+    int port;
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Sends one tile of each frame to one client
+class NetFrameSender
+{
+public:
+    // Throws if the address can't be resolved or there's no socket to send with
+    NetFrameSender(const NetFrameTile& tile, int keyframeInterval);
+    ~NetFrameSender();
+
+    // Send the tile's part of frame, unless it hasn't changed and no keyframe is due.
+    // If the socket can't take the whole frame, the rest is dropped and the next one
+    // sent is a keyframe. The tile must fit in frame, so check it against the frame
+    // size before creating the sender.
+    void Send(const ImageRGBA& frame);
+
+    // Send the last tile again as a keyframe if one is due. Nothing calls Send while
+    // the display is static, so call this every so often to keep clients that joined
+    // late or lost a packet in step. Safe to call from another thread than Send.
+    void SendKeyframeIfDue();
+
+    const NetFrameTile& Tile() const;
+    uint64_t FramesSent() const;
+    uint64_t BytesSent() const;
+
+private:
+    bool keyframeDue(FrameTimePoint now) const;
+    void sendTileFrame(bool keyframe, FrameTimePoint now);
+    bool sendPayload(bool keyframe);
+
+    // Guards everything below, for SendKeyframeIfDue
+    mutable std::mutex mutex_;
+
+    NetFrameTile tile_;
+    int keyframeInterval_;
+    int socket_;
+    std::vector<uint8_t> address_;  // sockaddr storage for the client
+
+    uint32_t sequence_;
+    int framesSinceKeyframe_;
+    bool keyframeNeeded_;
+    FrameTimePoint lastKeyframeTime_;
+
+    std::vector<uint8_t> tileFrame_;
+    std::vector<uint8_t> previous_;
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> packet_;
+
+    uint64_t framesSent_;
+    uint64_t bytesSent_;
+};
+
+// Receives frames sent to one port and puts them back together
+class NetFrameReceiver
+{
+public:
+    // Throws if the port can't be bound
+    NetFrameReceiver(int port, int width, int height);
+    ~NetFrameReceiver();
+
+    // Wait up to timeout for the next complete frame and decode it into frame, which
+    // must be the receiver's width and height. Returns false if none came in time.
+    bool Receive(ImageRGBA& frame, FrameDuration timeout);
+
+    uint64_t FramesReceived() const;
+
+    // Frames that never arrived whole, or couldn't be applied because one before them didn't
+    uint64_t FramesLost() const;
+
+private:
+    bool handlePacket(const uint8_t* packet, size_t size);
+    bool completeFrame();
+
+    int socket_;
+    int width_;
+    int height_;
+
+    // The frame being put back together
+    uint32_t sequence_;
+    uint8_t type_;
+    bool assembling_;
+    std::vector<std::vector<uint8_t>> fragments_;
+    std::vector<bool> fragmentReceived_;
+    int fragmentsMissing_;
+
+    // The last frame decoded, which the next delta applies to
+    std::vector<uint8_t> current_;
+    std::vector<uint8_t> payload_;
+    bool haveKeyframe_;
+    uint32_t lastSequence_;
+    bool sizeWarningShown_;
+
+    uint64_t framesReceived_;
+    uint64_t framesLost_;
+};
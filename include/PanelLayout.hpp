@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ImageRGBA.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Where one panel's pixels land in the logical frame
+struct PanelPlacement
+{
+    int x;          // Top left corner of the panel in the logical frame, after rotating it
+    int y;
+    int rotation;   // Clockwise, in degrees: 0, 90, 180 or 270
+};
+
+// How the LED panels are chained together, from the ledPanel config:
+//   ledPanel.cols, ledPanel.rows     size of one panel
+//   ledPanel.chainLength             panels per chain
+//   ledPanel.parallel                chains driven side by side
+//   ledPanel.layout                  one {"x": , "y": , "rotation": } per panel, chain by chain,
+//                                    from the panel nearest the connector outwards. Leave it
+//                                    empty for panels tiled left to right, chains top to bottom.
+//
+// The matrix's native buffer holds panel n of chain p at (n * cols, p * rows), so snakes,
+// U shapes and upside down panels are all just placements. Mapping a frame into that order
+// up front means the panel gets it one to one, without the library's per pixel mappers.
+class PanelLayout
+{
+public:
+    // Throws if a placement is missing, rotated oddly, or doesn't fit
+    PanelLayout(int cols, int rows, int chainLength, int parallel,
+                const std::vector<PanelPlacement>& placements,
+                int logicalWidth, int logicalHeight);
+
+    // Read the ledPanel config, for a logical frame the configured width and height
+    static PanelLayout FromConfig();
+
+    int Cols() const;
+    int Rows() const;
+    int ChainLength() const;
+    int Parallel() const;
+    int NativeWidth() const;
+    int NativeHeight() const;
+
+    // True if the native buffer is just the logical frame, so there's nothing to remap
+    bool IsIdentity() const;
+
+    // A native sized lookup image for GLRenderContext::ReadFrameRemapped. Each pixel holds
+    // the logical x (low byte in red, high in green) and y (low in blue, high in alpha) that
+    // it shows, or all 0xFF if no logical pixel lands there.
+    ImageRGBA BuildLookup() const;
+
+    // The same mapping on the CPU, for frames that didn't come from the render context
+    void Remap(const ImageRGBA& logical, ImageRGBA& native) const;
+
+private:
+    int cols_;
+    int rows_;
+    int chainLength_;
+    int parallel_;
+    int logicalWidth_;
+    int logicalHeight_;
+
+    // Logical pixel index for each native pixel, -1 for none
+    std::vector<int32_t> indexMap_;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Scene.hpp"
+#include "SnapshotBuffer.hpp"
 #include "Attributes.hpp"
 #include "PolyFill.hpp"
 
@@ -14,6 +15,7 @@ class PhysicsScene : public Scene
     
 private:
     virtual void initGLOverride() override;
+    virtual void releaseGLOverride() override;
     virtual void drawOverride() override;
     virtual void updateOverride() override;
     virtual void showOverride() override;
@@ -21,5 +23,14 @@ private:
     PolyFill bgFill;
     std::vector<PhysicsPoint> points;
     int updateCounter;
+
+    // Particle state as of the last update, published for the render thread
+    struct RenderState
+    {
+        std::vector<PhysicsPoint> points;
+        int updateCounter;
+    };
+    SnapshotBuffer<RenderState> renderState;
+    std::vector<PhysicsPoint> drawPoints;
 };
 
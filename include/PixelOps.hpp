@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Low level pixel buffer helpers. Most have NEON and SSE2/SSSE3 paths with a
+// scalar fallback, and every path produces identical results.
+
+// Fast, non-cryptographic 64 bit hash of a pixel buffer (XXH64), used to spot
+// frames that are identical to the last one without keeping a copy around
+uint64_t pixelChecksum(const uint8_t* data, size_t length);
+
+// True if two buffers hold the same bytes. Meant for comparing a row of
+// pixels against the same row of the last frame, so it's tuned for short runs.
+bool pixelRowsEqual(const uint8_t* a, const uint8_t* b, size_t length);
+
+// Pack a row of RGBA pixels into RGB by dropping alpha, e.g. for the shared frame
+// ring's RGB format. The LED panel doesn't use this, since SetPixel takes channels
+// one pixel at a time and packing them first would only add a pass.
+// rgb must have room for pixelCount * 3 bytes and must not overlap rgba.
+void rgbaToRgbRow(const uint8_t* rgba, uint8_t* rgb, size_t pixelCount);
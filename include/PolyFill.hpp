@@ -26,6 +26,7 @@ class PolyFill : public SceneElement
     void SetLocation(float x, float y);
     void Move(float dx, float dy);
     void SetColor(Color c);
+    virtual void ReleaseGL() override;
 protected:
     virtual void initGL() override;
     virtual void drawInternal() override;
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "HttpService.hpp"
+#include "DisplayDevice.hpp"
+
+#include <memory>
+
+struct PreviewState;
+
+// Serves what the display is showing over HTTP, so units in the field can be
+// checked from a browser:
+//   GET /display/snapshot           the current frame as a PNG
+//   GET /display/stream[?fps=N]     a multipart/x-mixed-replace stream of PNGs,
+//                                   which an <img> tag plays like MJPEG
+//
+// Frames come off the display's frame bus, and only while someone is watching.
+// A new viewer asks the display for a frame, so a static or sleeping display
+// still has something to show them.
+// PNG encoding happens on the preview's bus thread, once per frame however many
+// clients there are, and each client is held to its own frame rate (at most the
+// preview.maxFps config) so a slow or greedy browser can't hold up rendering.
+class PreviewService
+{
+public:
+    PreviewService(HttpService& http, DisplayDevice& display);
+    ~PreviewService();
+
+private:
+    // Shared with the HTTP handlers, which can outlive this object
+    std::shared_ptr<PreviewState> state_;
+    std::unique_ptr<FrameSubscription> frames_;
+    sigslot::scoped_connection settings_;
+};
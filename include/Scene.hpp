@@ -7,12 +7,14 @@
 #include "SceneElement.hpp"
 #include "TimeService.hpp"
 #include "HttpService.hpp"
+#include "MetricsService.hpp"
 
 // #include "EGL/egl.h"
 // #include "EGL/eglplatform.h"
 #include "GLES2/gl2.h"
 // #include "EGL/eglext.h"
 
+#include <atomic>
 #include <chrono>
 #include <string>
 
@@ -54,6 +56,8 @@ class Scene
     virtual void Show() final;
     
     // Update any animation variables and fetch any new data
+    // Runs on the update thread, so anything drawOverride needs
+    // must be published as a snapshot or go through a locked setter
     virtual void Update() final;
     
     // Called when scene is about to be hidden. Sets visibility false.
@@ -64,14 +68,30 @@ class Scene
     
     // Draw the scene to the current OpenGL context
     virtual void Draw() final;
+
+    // Free the scene's GPU resources, e.g. before deep sleep. They're loaded
+    // again the next time the scene is drawn. Render thread only.
+    virtual void ReleaseGL() final;
     
     virtual bool Visible() final;
     
     virtual SceneType GetSceneType() final;
+
+    // Ask for the scene to be updated and redrawn as soon as possible,
+    // e.g. because its settings or the scene time were changed
+    virtual void Wake() final;
+
+    // When the scene next wants Update() to be called
+    virtual FrameTimePoint NextUpdateTime() final;
+
+    // True if the scene changed since the last frame was drawn. Clears the request.
+    // Hidden scenes report this too, since the frame still shows them until redrawn.
+    virtual bool TakeRedrawRequest() final;
     
   protected:
     // Overrides for subclasses to customize behavior
     virtual void initGLOverride();
+    virtual void releaseGLOverride();
     virtual void registerEndpointsOverride(HttpService& http);
     virtual void drawOverride();
     virtual void updateOverride();
@@ -86,6 +106,20 @@ class Scene
     // Load a vert and frag shader and create a program with them
     std::unique_ptr<GfxProgram> loadProgram(std::string vertShaderName, std::string fragShaderName, std::vector<std::string> features);
 
+    // Time in seconds since this scene was last updated, for frame rate independent animation
+    double updateDelta();
+
+    // How often the scene wants to be updated and redrawn while visible.
+    // Scenes update on every tick by default. Zero means only when woken.
+    void setRefreshRate(double hz);
+
+    // Update again no later than the given time, on top of the refresh rate
+    void wakeAt(FrameTimePoint time);
+
+    // Draw the scene again on the next frame even if it doesn't update,
+    // e.g. while still blending between snapshots. Safe from any thread.
+    void requestRedraw();
+
     std::vector<SceneElement*> Elements;
     std::string BaseSceneName;
     bool clearBeforeDraw;
@@ -99,6 +133,18 @@ class Scene
     SceneType _sceneType;
     timepoint_seconds_t _showTime;
     fractionalSeconds _sceneLifetimeSeconds;
-    bool _isVisible;
+    std::atomic<bool> _isVisible;
+
+    FrameTimePoint _lastUpdateTime;
+    bool _lastUpdateTimeValid;
+    FrameDuration _updateDelta;
+
+    FrameDuration _refreshInterval;
+    std::atomic<FrameTimePoint> _nextUpdateTime;
+    std::atomic<bool> _redrawRequested;
+
+    // Update and Draw timings. Each is only touched by the thread that runs it.
+    MetricsPhase* _updateMetrics;
+    MetricsPhase* _drawMetrics;
 };
 
@@ -8,6 +8,10 @@ class SceneElement
  public:
     virtual ~SceneElement();
     virtual void Draw() final;
+
+    // Free this element's GPU resources, including any shared by every element
+    // of its type. They're created again the next time an element is drawn.
+    virtual void ReleaseGL();
 protected:
     SceneElement();
     virtual void drawInternal() = 0;
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A ring of finished frames in a POSIX shared memory segment, so other processes
+// (recorders, preview servers, a second panel driver) can pick up frames without
+// going through our GL context. There's one writer, MantleMap, and any number of readers.
+//
+// Layout, all offsets from the start of the segment:
+//   SharedFrameRingHeader                at 0
+//   slot i: SharedFrameSlotHeader        at header.headerSize + i * header.slotStride
+//           pixel data                   right after the slot header, header.frameSize bytes
+//
+// Each slot is guarded by a sequence lock. The writer makes the slot's sequence odd,
+// writes the frame, then makes it even again. Readers read in place, then check the
+// sequence didn't change while they were reading, so nobody ever blocks anybody.
+// Frame N always goes in slot N % slotCount, and header.latestFrame is N once it's complete.
+
+static constexpr uint32_t SHARED_FRAME_RING_MAGIC = 0x4D4D4652; // "MMFR"
+static constexpr uint32_t SHARED_FRAME_RING_VERSION = 1;
+
+enum class SharedFrameFormat : uint32_t
+{
+    RGBA8 = 0,  // 4 bytes per pixel, as rendered
+    RGB8 = 1    // 3 bytes per pixel, alpha dropped, rows in the same order as RGBA8
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The frame ring needs lock free 64 bit atomics to work across processes");
+
+struct alignas(64) SharedFrameRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    SharedFrameFormat format;
+    uint32_t stride;        // Bytes per row. Rows run top to bottom.
+    uint32_t slotCount;
+    uint32_t headerSize;    // Offset of the first slot
+    uint64_t slotStride;    // Bytes from one slot to the next, including its header
+    uint64_t frameSize;     // Bytes of pixel data in each slot
+    int64_t writerPid;
+    std::atomic<uint64_t> latestFrame;  // Number of the newest complete frame, 0 before the first one
+};
+
+// Everything after the sequence is only written while it's odd, so like the pixels
+// it's only good if the sequence is the same before and after reading it
+struct alignas(64) SharedFrameSlotHeader
+{
+    std::atomic<uint64_t> sequence;     // Odd while the slot is being written
+    std::atomic<uint64_t> frameNumber;
+    std::atomic<int64_t> timestampNs;   // Steady clock time the frame was published
+};
+
+// The writing side. Creates the segment, replacing any left over from before, and
+// removes it again when destroyed.
+class SharedFrameRingWriter
+{
+public:
+    SharedFrameRingWriter(const std::string& name, int width, int height, SharedFrameFormat format, int slotCount);
+    ~SharedFrameRingWriter();
+
+    SharedFrameRingWriter(const SharedFrameRingWriter&) = delete;
+    SharedFrameRingWriter& operator=(const SharedFrameRingWriter&) = delete;
+
+    // Get the next slot's pixel data to fill in. Readers skip it until EndWrite.
+    uint8_t* BeginWrite();
+
+    // Publish the frame written since BeginWrite
+    void EndWrite();
+
+    const SharedFrameRingHeader& Header() const;
+
+private:
+    std::string name_;
+    size_t size_;
+    uint8_t* base_;
+    SharedFrameRingHeader* header_;
+    SharedFrameSlotHeader* writing_;
+    uint64_t nextFrame_;
+};
+
+// The reading side, for consumers in other processes
+class SharedFrameRingReader
+{
+public:
+    // Throws if the segment doesn't exist or isn't a frame ring this code understands
+    explicit SharedFrameRingReader(const std::string& name);
+    ~SharedFrameRingReader();
+
+    SharedFrameRingReader(const SharedFrameRingReader&) = delete;
+    SharedFrameRingReader& operator=(const SharedFrameRingReader&) = delete;
+
+    const SharedFrameRingHeader& Header() const;
+
+    // Number of the newest complete frame, 0 if there hasn't been one yet
+    uint64_t LatestFrame() const;
+
+    // Where a frame lives and the sequence it had when we looked. The pixels
+    // are read in place; check Validate afterwards before trusting what was read.
+    struct FrameView
+    {
+        const uint8_t* pixels;
+        uint64_t frameNumber;
+        int64_t timestampNs;
+        uint64_t sequence;
+        const SharedFrameSlotHeader* slot;
+    };
+
+    // Look up a frame. Returns false if it's being written or has already been overwritten.
+    bool Acquire(uint64_t frameNumber, FrameView& view) const;
+
+    // True if the frame wasn't touched by the writer since Acquire
+    bool Validate(const FrameView& view) const;
+
+    // Copy a frame's pixels (header.frameSize bytes) out of the ring, along with when it
+    // was published, trying again if the writer gets to the slot mid-copy. Returns false
+    // if the frame isn't there any more or the writer kept getting in the way.
+    bool Read(uint64_t frameNumber, uint8_t* pixels, int64_t& timestampNs) const;
+
+private:
+    size_t size_;
+    const uint8_t* base_;
+    const SharedFrameRingHeader* header_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "TimeService.hpp"
+
+#include <atomic>
+#include <memory>
+
+// Hands render state from the update thread to the render thread.
+// The writer publishes a complete, immutable copy of the state every tick.
+// The reader grabs the latest snapshot, which carries both the newest state and
+// the one before it, so it can interpolate smoothly between update ticks.
+// Neither side ever waits on the other beyond swapping a shared pointer.
+template <typename T>
+class SnapshotBuffer
+{
+public:
+    struct Snapshot
+    {
+        T previous;
+        T current;
+        FrameTimePoint publishTime;
+        FrameDuration interval;  // Time between previous and current being published
+
+        // How far, [0,1], the given render time is from previous to current.
+        // Rendering one tick behind like this means we never have to extrapolate.
+        float Alpha(FrameTimePoint now) const
+        {
+            if (interval <= FrameDuration::zero())
+                return 1.0f;
+            float alpha = std::chrono::duration_cast<fractionalSeconds>(now - publishTime).count() /
+                          std::chrono::duration_cast<fractionalSeconds>(interval).count();
+            return alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+        }
+    };
+
+    // Publish a new state (update thread). Without blending, readers jump straight
+    // to the new state, which suits scenes that only update every now and then.
+    void Publish(const T& state, bool blend = true)
+    {
+        FrameTimePoint now = FrameClock::now();
+        std::shared_ptr<const Snapshot> last = std::atomic_load(&latest_);
+        blend = blend && last;
+
+        auto next = std::make_shared<Snapshot>();
+        next->previous = blend ? last->current : state;
+        next->current = state;
+        next->publishTime = now;
+        next->interval = blend ? now - last->publishTime : FrameDuration::zero();
+
+        std::atomic_store(&latest_, std::shared_ptr<const Snapshot>(std::move(next)));
+    }
+
+    // Get the newest snapshot, or nullptr if nothing has been published yet (render thread)
+    std::shared_ptr<const Snapshot> Latest() const
+    {
+        return std::atomic_load(&latest_);
+    }
+
+private:
+    std::shared_ptr<const Snapshot> latest_;
+};
@@ -4,6 +4,7 @@
 #include "PolyLine.hpp"
 #include "TextLabel.hpp"
 #include "Scene.hpp"
+#include "SnapshotBuffer.hpp"
 #include "AstronomyService.hpp"
 
 class SolarScene : public Scene
@@ -17,8 +18,22 @@ class SolarScene : public Scene
 protected:
     void updateOverride() override;
     void drawOverride() override;
+    void releaseGLOverride() override;
     
 private:
+    // Everything drawOverride needs beyond its elements, published by the update thread
+    struct RenderState
+    {
+      float sunX;
+      float sunY;
+      float moonX;
+      float moonY;
+      bool showMoon;
+      bool showSunrise;
+      bool showSunset;
+    };
+    SnapshotBuffer<RenderState> _renderState;
+
     AstronomyService& _astro;
     Color _moonColorDay;
     Color _moonColorNight;
@@ -47,6 +62,9 @@ private:
     
     double _sunriseJulian;
     double _sunsetJulian;
+
+    // The frame governor's quality scale the curves were last sampled at
+    float _curveQuality;
     
     bool _showMoon;
 };
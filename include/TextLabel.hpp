@@ -21,6 +21,7 @@ class TextLabel : public SceneElement
     void SetFlowDirection(FlowDirection direction);
     void SetAlignment(HAlign alignment);
     float GetLength();
+    virtual void ReleaseGL() override;
 
 protected:
     virtual void initGL() override;
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <nlohmann/json.hpp>
+
+// CPU affinity and scheduling for each class of thread the process runs, so the
+// panel refresh and render threads can have cores to themselves and aren't
+// preempted by HTTP traffic. Each class is configured under threads.<class>:
+//   cpus       CPUs the threads may run on, e.g. [3]. Empty for any the process started with.
+//   policy     "other" (the normal time sharing scheduler), "fifo" or "rr" (real time)
+//   priority   real time priority, 1 to 99, for fifo and rr
+//   nice       niceness, -20 to 19, for other
+// and threads.lockMemory locks every page of the process into RAM (mlockall) so
+// page faults can't stall a real time thread. That includes the whole stack of every
+// thread started afterwards, which is 8 MB each by default (ulimit -s), and there are
+// a couple of dozen threads with the HTTP workers and bus subscribers. On a Pi, set
+// threads.stackSizeKB as well (e.g. 512) to shrink the stacks of threads started
+// after Init; it's left alone when 0.
+//
+// The classes are:
+//   render     the main thread, which draws and reads back frames
+//   update     scene simulation (UpdateLoop)
+//   panel      the LED matrix library's refresh thread
+//   present    the LED panel's present thread
+//   convert    the LED panel's banded readback workers (ledPanel.convertThreads of them),
+//              which convert rows in parallel, so give them one CPU each rather than
+//              pinning them all to the present thread's single core
+//   http       the web server's listener and worker threads
+//   weather    the weather scene's fetch thread
+//   button     the USB button reader
+//   output     frame bus subscribers (preview, extra displays) and net display keyframes
+//
+// Threads inherit their creator's settings, so every thread a class covers has its
+// class's settings applied explicitly, with anything left at its default going back
+// to what the process started with. Nothing is touched if no class is configured.
+// Settings are read once at startup. Real time policies, negative nice values and
+// mlockall need root or CAP_SYS_NICE / CAP_IPC_LOCK; failures are logged and reported
+// rather than being fatal.
+class ThreadPolicy
+{
+public:
+    ThreadPolicy() = delete;
+
+    // Read the threads config and lock memory if asked to. Call on the main thread,
+    // before starting any other threads.
+    static void Init();
+
+    // Apply a class's settings to the calling thread
+    static void Apply(const std::string& threadClass);
+
+    // Apply a class's settings to the calling thread the first time it's called on it
+    static void ApplyOnce(const std::string& threadClass);
+
+    // Apply a class's settings to another thread of this process
+    static void ApplyToThread(const std::string& threadClass, pid_t tid);
+
+    // Kernel thread ids of every thread in the process (from /proc/self/task)
+    static std::vector<pid_t> ProcessThreads();
+
+    // The calling thread's kernel thread id
+    static pid_t CurrentThread();
+
+    // A thread's name (its comm). New threads start out with their creator's.
+    static std::string ThreadName(pid_t tid);
+
+    // Rename a thread of this process. Linux keeps the first 15 characters.
+    static void SetThreadName(pid_t tid, const std::string& name);
+
+    // What each class asked for and which threads it was applied to, with any errors
+    static nlohmann::json Report();
+};
@@ -8,8 +8,16 @@ typedef std::chrono::duration<double, std::ratio<86400, 1>> fractionalDays;
 typedef std::chrono::time_point<std::chrono::system_clock, fractionalDays > timepoint_t;
 typedef std::chrono::time_point<std::chrono::system_clock, fractionalSeconds > timepoint_seconds_t;
 typedef std::chrono::time_point<std::chrono::system_clock, std::chrono::seconds> sys_seconds;
-typedef std::chrono::high_resolution_clock::time_point FrameTimePoint;
-typedef std::chrono::high_resolution_clock::duration FrameDuration;
+typedef std::chrono::steady_clock FrameClock;
+typedef FrameClock::time_point FrameTimePoint;
+typedef FrameClock::duration FrameDuration;
+
+// What the frame pacer should do when a frame finishes after its deadline
+enum class FrameOverrunPolicy
+{
+  Skip,     // Drop the missed slots and realign to the next future deadline
+  CatchUp   // Run missed frames back to back until we are on schedule again
+};
 
 class TimeService
 {
@@ -76,4 +84,16 @@ public:
     // Record now as when the current frame finished rendering.
     // If (thisTp - lastTp) < TargetFrameDelta, wait until lastTp + TargetFrameDelta
     static void FinishAndWaitForNextFrame();
+
+    // Set the target frame rate for FinishAndWaitForNextFrame
+    static void SetTargetFrameRate(double fps);
+
+    // Choose whether overrunning frames are skipped or caught up
+    static void SetFrameOverrunPolicy(FrameOverrunPolicy policy);
+
+    // How long before a frame deadline to switch from sleeping to spinning
+    static void SetFrameSpinThreshold(FrameDuration threshold);
+
+    // Restart frame pacing, e.g. when the render loop resumes after sleeping
+    static void ResetFrameTiming();
 };
\ No newline at end of file
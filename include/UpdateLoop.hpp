@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Scene.hpp"
+#include "FramePacer.hpp"
+#include "WakeSignal.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs Scene::Update on its own thread so expensive simulation work never
+// adds to the render thread's frame time. Each visible scene is only updated
+// when it's due (see Scene::setRefreshRate), at most once per tick, and the
+// thread sleeps until the next scene is due in between.
+// Scenes publish whatever their Draw needs as snapshots (see SnapshotBuffer).
+class UpdateLoop
+{
+public:
+    UpdateLoop(const std::vector<Scene*>& baseScenes, const std::vector<Scene*>& overlayScenes);
+    ~UpdateLoop();
+
+    // Start and stop the update thread
+    void Start();
+    void Stop();
+
+    // Maximum ticks per second. Safe to call from any thread.
+    void SetTickRate(double hz);
+
+    // While paused the update thread sleeps without ticking. Safe to call from any thread.
+    void SetPaused(bool paused);
+
+    // Update every scene that's due on the calling thread.
+    // Returns when the next scene will be due.
+    FrameTimePoint Tick();
+
+    // Wake every scene so they all update on the next tick, and wake the
+    // update thread if it's waiting. Safe to call from any thread.
+    void WakeAll();
+
+    // Notify this signal whenever a tick updates at least one scene,
+    // so the render loop can sleep until there's something new to draw
+    void SetWakeSignal(WakeSignal* wakeSignal);
+
+    // Hold this lock to touch scene state (show, hide, reset, settings changes)
+    // from outside the update thread. Ticks never run while it's held.
+    std::unique_lock<std::mutex> LockScenes();
+
+private:
+    void run();
+
+    const std::vector<Scene*>& baseScenes_;
+    const std::vector<Scene*>& overlayScenes_;
+
+    std::mutex sceneMutex_;
+
+    std::mutex stateMutex_;
+    std::condition_variable stateChanged_;
+    bool paused_;
+    bool stopRequested_;
+    bool wakeRequested_;
+
+    std::atomic<WakeSignal*> wakeSignal_;
+
+    std::atomic<double> tickRate_;
+    FramePacer pacer_;
+    std::unique_ptr<std::thread> thread_;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "TimeService.hpp"
+
+// Lets one thread block with zero CPU until another thread (or a signal
+// handler) has something for it. Backed by an eventfd on Linux and a
+// self-pipe elsewhere, so Notify() is safe to call from a signal handler.
+// Notifications aren't lost if nobody is waiting yet: the next wait just
+// returns straight away. Any number of notifications wake the waiter once.
+class WakeSignal
+{
+public:
+    WakeSignal();
+    ~WakeSignal();
+    WakeSignal(const WakeSignal&) = delete;
+    WakeSignal& operator=(const WakeSignal&) = delete;
+
+    // Wake the waiting thread. Safe from any thread and from signal handlers.
+    void Notify();
+
+    // Block until notified (or interrupted by a signal)
+    void Wait();
+
+    // Block until notified or the timeout passes. Returns true if notified.
+    bool WaitFor(FrameDuration timeout);
+
+private:
+    bool wait(int timeoutMs);
+    void drain();
+
+    int readFd_;
+    int writeFd_;
+};
@@ -0,0 +1,48 @@
+// Final pass over the finished frame: gamma / white balance, then quantize
+// to the levels the LED panel can actually show, with ordered dithering
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+varying vec2 vTexCoord;
+uniform sampler2D uTexture;   // The frame the scenes drew
+uniform sampler2D uTexture1;  // 256x3 LUT, a row each for red, green and blue.
+                              // Entries are 16 bit, high byte in red and low byte in green.
+uniform float uLevels;        // Highest level the panel can show (2^pwmBits - 1)
+uniform float uLevelStep;     // 8 bit output value per level
+uniform float uDither;        // 1 for ordered dithering, 0 to round to the nearest level
+
+// Ordered dither thresholds in [0,1) from an 8x8 Bayer matrix
+float bayer2(vec2 a)
+{
+  a = floor(a);
+  return fract(dot(a, vec2(0.5, a.y * 0.75)));
+}
+
+float bayer4(vec2 a)
+{
+  return bayer2(0.5 * a) * 0.25 + bayer2(a);
+}
+
+float bayer8(vec2 a)
+{
+  return bayer4(0.5 * a) * 0.25 + bayer2(a);
+}
+
+float lookup(float value, float row)
+{
+  vec4 entry = texture2D(uTexture1, vec2((value * 255.0 + 0.5) / 256.0, (row + 0.5) / 3.0));
+  return entry.r * (65280.0 / 65535.0) + entry.g * (255.0 / 65535.0);
+}
+
+void main(void)
+{
+  vec3 color = texture2D(uTexture, vTexCoord).rgb;
+  vec3 corrected = vec3(lookup(color.r, 0.0), lookup(color.g, 1.0), lookup(color.b, 2.0));
+  float threshold = uDither > 0.5 ? bayer8(gl_FragCoord.xy) : 0.5;
+  vec3 level = min(floor(corrected * uLevels + threshold), uLevels);
+  gl_FragColor = vec4(level * uLevelStep / 255.0, 1.0);
+}
@@ -0,0 +1,26 @@
+// Gathers each native panel pixel from wherever it sits in the logical frame
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+varying vec2 vTexCoord;
+uniform sampler2D uTexture;   // The logical frame
+uniform sampler2D uTexture1;  // Native sized lookup, see PanelLayout::BuildLookup
+uniform vec2 uFrameSize;      // Size of the logical frame in pixels
+
+void main(void)
+{
+  vec4 entry = floor(texture2D(uTexture1, vTexCoord) * 255.0 + 0.5);
+  vec2 source = vec2(entry.r + entry.g * 256.0, entry.b + entry.a * 256.0);
+  if (source.x >= uFrameSize.x || source.y >= uFrameSize.y)
+  {
+    gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+  }
+  else
+  {
+    gl_FragColor = texture2D(uTexture, (source + 0.5) / uFrameSize);
+  }
+}
@@ -0,0 +1,12 @@
+// Fullscreen pass for GLRenderContext::ReadFrameRemapped.
+// Vertices come in clip space since the target isn't the size of the display.
+
+attribute vec4 aVertex;
+attribute vec2 aTexCoord;
+varying vec2 vTexCoord;
+
+void main(void)
+{
+  vTexCoord = aTexCoord;
+  gl_Position = aVertex;
+}
@@ -0,0 +1,127 @@
+#include "BandedReadback.hpp"
+#include "ThreadPolicy.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// One worker's queue of bands. Each worker only ever touches its own rows of a band.
+struct BandWorker
+{
+    int index;
+    int stride;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::pair<int, int>> bands;
+    const BandedReadback::RowConverter* convertRow = nullptr;
+    int outstanding = 0;
+    bool stopping = false;
+    std::unique_ptr<std::thread> thread;
+
+    void Post(int firstRow, int rows)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bands.emplace_back(firstRow, rows);
+            outstanding++;
+        }
+        changed.notify_all();
+    }
+
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return outstanding == 0; });
+    }
+
+    void Run()
+    {
+        // Workers run side by side, so their class needs a CPU for each of them
+        ThreadPolicy::Apply("convert");
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            changed.wait(lock, [&]() { return stopping || !bands.empty(); });
+            if (stopping)
+                break;
+
+            auto band = bands.front();
+            bands.pop_front();
+            const BandedReadback::RowConverter& convert = *convertRow;
+            lock.unlock();
+
+            // The first of this worker's rows in the band, then every stride-th one after it
+            int y = band.first + ((index - band.first % stride) + stride) % stride;
+            for (; y < band.first + band.second; y += stride)
+            {
+                convert(index, y);
+            }
+
+            lock.lock();
+            outstanding--;
+            if (outstanding == 0)
+            {
+                changed.notify_all();
+            }
+        }
+    }
+};
+
+BandedReadback::BandedReadback(int workers)
+{
+    int count = workers >= 4 ? 4 : (workers >= 2 ? 2 : 1);
+    for (int i=0; i < count; i++)
+    {
+        auto worker = std::make_unique<BandWorker>();
+        worker->index = i;
+        worker->stride = count;
+        BandWorker* raw = worker.get();
+        worker->thread = std::make_unique<std::thread>([raw]() { raw->Run(); });
+        workers_.push_back(std::move(worker));
+    }
+}
+
+BandedReadback::~BandedReadback()
+{
+    for (auto& worker : workers_)
+    {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->stopping = true;
+        }
+        worker->changed.notify_all();
+        worker->thread->join();
+    }
+}
+
+int BandedReadback::Workers() const
+{
+    return workers_.size();
+}
+
+bool BandedReadback::Read(GLRenderContext& render, ImageRGBA& frame, int bandRows, const RowConverter& convertRow)
+{
+    for (auto& worker : workers_)
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->convertRow = &convertRow;
+    }
+
+    bool read = render.ReadFrameBands(frame, bandRows, [&](int firstRow, int rows)
+    {
+        for (auto& worker : workers_)
+        {
+            worker->Post(firstRow, rows);
+        }
+    });
+
+    // Whatever was posted has to finish before convertRow goes out of scope, frame or not
+    for (auto& worker : workers_)
+    {
+        worker->WaitIdle();
+    }
+    return read;
+}
@@ -0,0 +1,403 @@
+#include "Benchmark.hpp"
+#include "TimeService.hpp"
+#include "BandedReadback.hpp"
+
+#include "ConfigService.hpp"
+static auto& config = ConfigService::global;
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using json = nlohmann::json;
+
+// Scene time is frozen here so every run draws exactly the same frames
+static const int BENCH_YEAR = 2024;
+static const int BENCH_MONTH = 6;
+static const int BENCH_DAY = 20;
+static const int BENCH_HOUR = 12;
+
+// Frames drawn before timing starts, so texture and shader loading aren't measured
+static const int WARMUP_FRAMES = 5;
+
+// Band sizes tried for banded readback (see BandedReadback.hpp), 0 being the whole frame
+static const std::vector<int> BENCH_BAND_ROWS = { 0, 8, 16, 32, 64 };
+
+namespace
+{
+    struct Samples
+    {
+        std::vector<double> update;
+        std::vector<double> draw;
+        std::vector<double> readback;
+        std::vector<double> frame;
+    };
+
+    // Does about what the LED panel library's SetPixel does, which only exists on a Pi:
+    // looks each channel up in a gamma table, then sets or clears its bit in one word
+    // per PWM bit plane of a canvas-sized buffer. Each row has its own words, so
+    // workers converting different rows never share one.
+    struct CanvasStandIn
+    {
+        int width;
+        int pwmBits;
+        uint16_t levels[256];
+        std::vector<uint32_t> planes;
+
+        CanvasStandIn(int width, int height, int pwmBits) :
+            width(width),
+            pwmBits(std::clamp(pwmBits, 1, 11)),
+            planes((size_t)width * height * this->pwmBits)
+        {
+            for (int i=0; i < 256; i++)
+            {
+                levels[i] = (uint16_t)std::lround(std::pow(i / 255.0, 2.2) * ((1 << this->pwmBits) - 1));
+            }
+        }
+
+        void SetRow(const uint8_t* rgba, int y)
+        {
+            uint32_t* row = planes.data() + (size_t)y * pwmBits * width;
+            for (int x=0; x < width; x++, rgba += 4)
+            {
+                uint16_t r = levels[rgba[0]];
+                uint16_t g = levels[rgba[1]];
+                uint16_t b = levels[rgba[2]];
+                for (int bit=0; bit < pwmBits; bit++)
+                {
+                    uint32_t colorBits = ((r >> bit) & 1) | (((g >> bit) & 1) << 1) | (((b >> bit) & 1) << 2);
+                    uint32_t& word = row[bit * width + x];
+                    word = (word & ~7u) | colorBits;
+                }
+            }
+        }
+    };
+}
+
+static double microsecondsSince(FrameTimePoint start)
+{
+    return std::chrono::duration<double, std::micro>(FrameClock::now() - start).count();
+}
+
+static json percentiles(std::vector<double> samples)
+{
+    if (samples.empty())
+        return json::object();
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double p)
+    {
+        // Nearest rank
+        size_t rank = (size_t)std::max(0.0, std::ceil(p * samples.size()) - 1.0);
+        return samples[std::min(rank, samples.size() - 1)];
+    };
+
+    return json
+    {
+        {"p50", at(0.50)},
+        {"p90", at(0.90)},
+        {"p99", at(0.99)},
+        {"max", samples.back()}
+    };
+}
+
+static void freezeSceneTime()
+{
+    std::tm benchTime {};
+    benchTime.tm_year = BENCH_YEAR - 1900;
+    benchTime.tm_mon = BENCH_MONTH - 1;
+    benchTime.tm_mday = BENCH_DAY;
+    benchTime.tm_hour = BENCH_HOUR;
+    benchTime.tm_isdst = -1;
+    TimeService::SetSceneTime(benchTime);
+    TimeService::PauseSceneTime();
+}
+
+Benchmark::Benchmark(const std::vector<Scene*>& baseScenes, const std::vector<Scene*>& overlayScenes, GLRenderContext& render, DisplayDevice& display) :
+    baseScenes_(baseScenes),
+    overlayScenes_(overlayScenes),
+    render_(render),
+    display_(display)
+{
+}
+
+json Benchmark::Run(int frames)
+{
+    std::map<std::string, Samples> results;
+
+    for (Scene* scene : baseScenes_)
+    {
+        // Every scene starts from the same state, including its random numbers
+        freezeSceneTime();
+        srand(0);
+        for (Scene* other : baseScenes_)
+        {
+            other->Hide();
+        }
+        scene->Show();
+        for (Scene* overlay : overlayScenes_)
+        {
+            overlay->OnSceneChanged(scene->SceneName());
+        }
+
+        Samples& sceneSamples = results[scene->SceneName()];
+
+        for (int i = -WARMUP_FRAMES; i < frames; i++)
+        {
+            bool record = i >= 0;
+            FrameTimePoint frameStart = FrameClock::now();
+
+            FrameTimePoint start = FrameClock::now();
+            scene->Update();
+            if (record) sceneSamples.update.push_back(microsecondsSince(start));
+
+            for (Scene* overlay : overlayScenes_)
+            {
+                if (!overlay->Visible())
+                    continue;
+                start = FrameClock::now();
+                overlay->Update();
+                if (record) results[overlay->SceneName()].update.push_back(microsecondsSince(start));
+            }
+
+            render_.BeginDraw();
+
+            start = FrameClock::now();
+            scene->Draw();
+            if (record) sceneSamples.draw.push_back(microsecondsSince(start));
+
+            for (Scene* overlay : overlayScenes_)
+            {
+                if (!overlay->Visible())
+                    continue;
+                start = FrameClock::now();
+                overlay->Draw();
+                if (record) results[overlay->SceneName()].draw.push_back(microsecondsSince(start));
+            }
+
+            render_.EndDraw();
+
+            // Reading back waits for the GPU, so this includes however much of the
+            // frame it hadn't finished yet
+            start = FrameClock::now();
+            display_.Update(render_);
+            if (record) sceneSamples.readback.push_back(microsecondsSince(start));
+
+            if (record) sceneSamples.frame.push_back(microsecondsSince(frameStart));
+        }
+
+        // Don't let this scene's queued work land on the next one's numbers
+        glFinish();
+        scene->Hide();
+    }
+
+    json report;
+    report["frames"] = frames;
+    report["width"] = config.width();
+    report["height"] = config.height();
+    report["pipelineDepth"] = render_.GetPipelineDepth();
+    report["display"] = display_.GetBackendName();
+    report["readbackMode"] = render_.GetReadbackMode() == ReadbackMode::PixelBuffer ? "pixelBuffer" : "framebuffer";
+    report["units"] = "us";
+
+    json scenes = json::object();
+    for (auto& [name, samples] : results)
+    {
+        json s;
+        s["update"] = percentiles(samples.update);
+        s["draw"] = percentiles(samples.draw);
+        if (!samples.readback.empty())
+        {
+            s["readback"] = percentiles(samples.readback);
+            s["frame"] = percentiles(samples.frame);
+        }
+        scenes[name] = s;
+    }
+    report["scenes"] = scenes;
+    report["readbackBands"] = runBandSweep(frames);
+    report["deepSleep"] = runDeepSleep();
+
+    return report;
+}
+
+// Go through deep sleep the way the main loop does, keeping the render context and then
+// releasing it, and check a frame comes out the other side. The main loop renders as many
+// frames as GetPipelineDepth says after waking, so that has to be back as well.
+json Benchmark::runDeepSleep()
+{
+    if (baseScenes_.empty())
+        return json::object();
+
+    Scene* scene = baseScenes_.front();
+    freezeSceneTime();
+    srand(0);
+    scene->Show();
+
+    ImageRGBA frame(config.width(), config.height());
+    json results = json::object();
+    for (bool releaseContext : { false, true })
+    {
+        render_.MakeCurrent();
+        for (Scene* other : baseScenes_)
+        {
+            other->ReleaseGL();
+        }
+        for (Scene* overlay : overlayScenes_)
+        {
+            overlay->ReleaseGL();
+        }
+        render_.Suspend(releaseContext);
+        display_.Suspend();
+
+        FrameTimePoint start = FrameClock::now();
+        display_.Resume();
+        render_.Resume();
+        double resumeUs = microsecondsSince(start);
+
+        int framesToRender = render_.GetPipelineDepth();
+        bool frameRead = false;
+        start = FrameClock::now();
+        for (int i=0; i < framesToRender; i++)
+        {
+            render_.BeginDraw();
+            scene->Draw();
+            render_.EndDraw();
+            frameRead = render_.ReadFrame(frame) || frameRead;
+        }
+        glFinish();
+
+        results[releaseContext ? "releaseContext" : "keepContext"] =
+        {
+            {"pipelineDepth", framesToRender},
+            {"resumeUs", resumeUs},
+            {"firstFramesUs", microsecondsSince(start)},
+            {"passed", frameRead}
+        };
+    }
+
+    scene->Hide();
+    return results;
+}
+
+json Benchmark::runBandSweep(int frames)
+{
+    if (baseScenes_.empty())
+        return json::object();
+
+    // The first scene is drawn each frame so there's something to wait for. The LED
+    // panel's SetPixel only exists on a Pi, so rows are converted with a stand-in
+    // that costs about the same (see CanvasStandIn).
+    Scene* scene = baseScenes_.front();
+    freezeSceneTime();
+    srand(0);
+    scene->Show();
+
+    int width = config.width();
+    int height = config.height();
+    int workers = config.GetConfigValue("ledPanel.convertThreads", 2);
+    int pwmBits = config.GetConfigValue("ledPanel.pwmBits", 6);
+    BandedReadback banded(workers);
+    ImageRGBA frame(width, height);
+    CanvasStandIn canvas(width, height, pwmBits);
+
+    json bands = json::object();
+    for (int bandRows : BENCH_BAND_ROWS)
+    {
+        if (bandRows >= height)
+            continue;
+
+        std::vector<double> samples;
+        for (int i = -WARMUP_FRAMES; i < frames; i++)
+        {
+            render_.BeginDraw();
+            scene->Draw();
+            render_.EndDraw();
+
+            FrameTimePoint start = FrameClock::now();
+            bool read = banded.Read(render_, frame, bandRows, [&](int worker, int y)
+            {
+                canvas.SetRow(frame.data() + y * width * 4, y);
+            });
+            if (read && i >= 0)
+            {
+                samples.push_back(microsecondsSince(start));
+            }
+        }
+        glFinish();
+        bands[bandRows == 0 ? "whole" : std::to_string(bandRows)] = percentiles(samples);
+    }
+
+    // What a pipelined LED panel does instead: read the whole frame back, then hand it to
+    // a present thread that converts it while the next frame is drawn. Timed is what the
+    // render thread spends on each frame, which includes waiting for the present thread
+    // to take it if it's still busy with the last one.
+    std::mutex presentMutex;
+    std::condition_variable presentCondition;
+    ImageRGBA presentFrame(width, height);
+    bool framePending = false;
+    bool stopPresenting = false;
+    std::thread presentThread([&]()
+    {
+        std::unique_lock<std::mutex> lock(presentMutex);
+        while (true)
+        {
+            presentCondition.wait(lock, [&]() { return framePending || stopPresenting; });
+            if (!framePending)
+                break;
+
+            lock.unlock();
+            for (int y=0; y < height; y++)
+            {
+                canvas.SetRow(presentFrame.data() + y * width * 4, y);
+            }
+            lock.lock();
+            framePending = false;
+            presentCondition.notify_all();
+        }
+    });
+
+    std::vector<double> presentSamples;
+    for (int i = -WARMUP_FRAMES; i < frames; i++)
+    {
+        render_.BeginDraw();
+        scene->Draw();
+        render_.EndDraw();
+
+        FrameTimePoint start = FrameClock::now();
+        if (!render_.ReadFrame(frame))
+            continue;
+        {
+            std::unique_lock<std::mutex> lock(presentMutex);
+            presentCondition.wait(lock, [&]() { return !framePending; });
+            std::swap(frame, presentFrame);
+            framePending = true;
+        }
+        presentCondition.notify_all();
+        if (i >= 0)
+        {
+            presentSamples.push_back(microsecondsSince(start));
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(presentMutex);
+        presentCondition.wait(lock, [&]() { return !framePending; });
+        stopPresenting = true;
+    }
+    presentCondition.notify_all();
+    presentThread.join();
+    glFinish();
+
+    scene->Hide();
+    return json
+    {
+        {"workers", banded.Workers()},
+        {"pwmBits", canvas.pwmBits},
+        {"readAndConvert", bands},
+        {"presentThread", percentiles(presentSamples)}
+    };
+}
@@ -15,6 +15,11 @@ void CmdDebugScene::initGLOverride()
 {
 }
 
+void CmdDebugScene::releaseGLOverride()
+{
+  _cmdLabel.ReleaseGL();
+}
+
 const char* CmdDebugScene::SceneName()
 {
   return "CmdDebug";
@@ -34,7 +39,7 @@ void CmdDebugScene::updateOverride()
       showPos = (int)(distPerFrame * (float)(_cmdShowCounter - _framesToHoldCmd));
     }
     
-    _cmdLabel.SetPosition(-showPos, 0);
+    _renderState.Publish({_cmdShowCounter < (_framesToHoldCmd + _framesToScrollCmd), showPos}, false);
   }
 }
 
@@ -46,10 +51,15 @@ void CmdDebugScene::ShowCmd(std::string query)
   
   _cmdShowCounter = 0;
   _framesToScrollCmd = _cmdLabel.GetLength() * 3;
+  _renderState.Publish({true, 0}, false);
 }
 
 void CmdDebugScene::drawOverride()
 {
-  if (_cmdShowCounter < (_framesToHoldCmd + _framesToScrollCmd))
-	  _cmdLabel.Draw();
+  auto snapshot = _renderState.Latest();
+  if (!snapshot || !snapshot->current.showing)
+    return;
+
+  _cmdLabel.SetPosition(-snapshot->current.showPos, 0);
+  _cmdLabel.Draw();
 }
@@ -0,0 +1,85 @@
+#include "CommandQueue.hpp"
+
+#include <iostream>
+#include <exception>
+
+// This is an intrusive MPSC queue in the style of Dmitry Vyukov's.
+// The queue always holds a stub node at the tail which has already been
+// consumed, so producers and the consumer never touch the same node's
+// payload at the same time.
+
+CommandQueue::CommandQueue() :
+    wakeSignal_(nullptr)
+{
+    Node* stub = new Node();
+    head_.store(stub, std::memory_order_relaxed);
+    tail_ = stub;
+}
+
+CommandQueue::~CommandQueue()
+{
+    Node* node = tail_;
+    while (node != nullptr)
+    {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+    }
+}
+
+void CommandQueue::Post(std::function<void()> command)
+{
+    Node* node = new Node();
+    node->command = std::move(command);
+
+    // Claim our spot at the head, then link the previous head to us.
+    // Until that link is published the consumer just sees a shorter queue.
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+
+    WakeSignal* wakeSignal = wakeSignal_.load(std::memory_order_acquire);
+    if (wakeSignal != nullptr)
+    {
+        wakeSignal->Notify();
+    }
+}
+
+void CommandQueue::SetWakeSignal(WakeSignal* wakeSignal)
+{
+    wakeSignal_.store(wakeSignal, std::memory_order_release);
+}
+
+bool CommandQueue::Empty() const
+{
+    return tail_->next.load(std::memory_order_acquire) == nullptr;
+}
+
+int CommandQueue::Drain()
+{
+    int count = 0;
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    while (next != nullptr)
+    {
+        // The next node becomes the new stub once we take its command
+        std::function<void()> command = std::move(next->command);
+        delete tail_;
+        tail_ = next;
+
+        try
+        {
+            command();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Queued command threw: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "Queued command threw an unknown exception" << std::endl;
+        }
+
+        count++;
+        next = tail_->next.load(std::memory_order_acquire);
+    }
+    return count;
+}
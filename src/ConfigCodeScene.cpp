@@ -34,6 +34,9 @@ ConfigCodeScene::ConfigCodeScene(HttpService& http) : Scene(SceneType::Base, Sce
   urlLabel.SetAlignment(HAlign::Center);
   urlLabel.SetPosition(config.width() / 2.0f, config.height() / 2.0f + 22);
   urlLabel.SetColor(0.5, 0.5, 0.5, 1.0);
+
+  // Nothing here ever changes after it's shown
+  setRefreshRate(0);
 }
 
 ConfigCodeScene::~ConfigCodeScene()
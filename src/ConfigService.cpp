@@ -147,12 +147,12 @@ void ConfigService::Init()
     }
 }
 
-void ConfigService::Subscribe(const std::function <void (const ConfigUpdateEventArg&)>& handler) 
+sigslot::connection ConfigService::Subscribe(const std::function <void (const ConfigUpdateEventArg&)>& handler) 
 {
     if (!_initDone) throw std::runtime_error("Config service is not initialized!");
     ConfigUpdateEventArg arg(*this, "", true);
     handler(arg);
-    OnSettingChanged.connect(handler);
+    return OnSettingChanged.connect(handler);
 }
 
 int ConfigService::width() const
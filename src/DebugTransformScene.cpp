@@ -27,6 +27,9 @@ DebugTransformScene::DebugTransformScene() : Scene(SceneType::Base, SceneLifetim
     
     _label8.SetText("DEBUG");
     _label8.SetPosition(0,0);
+
+    // Static test pattern, only needs drawing when shown
+    setRefreshRate(0);
 }
 
 DebugTransformScene::~DebugTransformScene()
@@ -59,6 +62,12 @@ void DebugTransformScene::initGLOverride()
             (float)LonLatLookupTexture->GetWidth(), (float)LonLatLookupTexture->GetHeight(),  0.0f,   1.0f,   1.0f  };
 }
 
+void DebugTransformScene::releaseGLOverride()
+{
+    program.reset();
+    LonLatLookupTexture.reset();
+}
+
 void DebugTransformScene::drawOverride()
 {
     program->Use();
@@ -1,11 +1,355 @@
 #include "DisplayDevice.hpp"
+#include "GLRenderContext.hpp"
 #include "GLError.hpp"
+#include "ImageRGBA.hpp"
+#include "PixelOps.hpp"
+#include "MetricsService.hpp"
+#include "SharedFrameRing.hpp"
+#include "FrameRecording.hpp"
+#include "NetFrameStream.hpp"
+#include "PanelLayout.hpp"
+#include "ThreadPolicy.hpp"
+#include "BandedReadback.hpp"
+#include "TimeService.hpp"
+#include "Utils.hpp"
 #include "ConfigService.hpp"
 static auto& config = ConfigService::global;
 
-#ifdef LED_PANEL_SUPPORT
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
 
-#include "ImageRGBA.hpp"
+// Remembers a checksum of the last frame sent to the display so
+// unchanged frames can skip the expensive trip to the hardware.
+// Safe on any thread: the LED panel checks frames on its present thread
+// while the main thread clears the display or changes the setting.
+struct DuplicateFrameFilter
+{
+    std::mutex mutex;
+    bool enabled = true;
+    bool lastValid = false;
+    uint64_t lastChecksum = 0;
+    std::atomic<uint64_t> suppressedFrames{0};
+    sigslot::scoped_connection settingsConnection;
+
+    DuplicateFrameFilter()
+    {
+        settingsConnection = config.Subscribe([&](const ConfigUpdateEventArg& arg)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (arg.UpdateIfChanged("suppressDuplicateFrames", enabled, true))
+            {
+                lastValid = false;
+            }
+        });
+    }
+
+    // Returns true if the frame matches the last one seen
+    bool IsDuplicate(const ImageRGBA& frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!enabled)
+                return false;
+        }
+
+        // Hashing is the slow part, so it's done without the lock. If the filter was
+        // invalidated meanwhile, lastValid is false and this just becomes the new last frame.
+        uint64_t checksum = pixelChecksum(frame.data(), frame.width() * frame.height() * 4);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (lastValid && checksum == lastChecksum)
+        {
+            suppressedFrames++;
+            return true;
+        }
+
+        lastChecksum = checksum;
+        lastValid = true;
+        return false;
+    }
+
+    // Forget the last frame, e.g. because the display was cleared
+    void Invalidate()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lastValid = false;
+    }
+};
+
+// Somewhere to send frames. DisplayDevice picks one of these when it's created.
+struct DisplayBackend
+{
+    ImageRGBA CPUTextureCache;
+
+    // Sees every frame read back from the render context before it's presented
+    std::function<void(const ImageRGBA&)> onFrameRead;
+
+    // Whether anyone outside the display wants frames on the CPU, for displays
+    // that don't need to read them back themselves
+    std::function<bool()> frameWanted;
+
+    DisplayBackend() : CPUTextureCache(config.width(), config.height())
+    {
+    }
+
+    virtual ~DisplayBackend() = default;
+
+    // Read the oldest finished frame back from the render context and present it
+    virtual void Update(GLRenderContext& render)
+    {
+        static MetricsPhase& metrics = MetricsService::Phase("display.readback");
+
+        {
+            MetricsTimer timer(metrics);
+            if (!render.ReadFrame(CPUTextureCache))
+                return;
+        }
+        if (onFrameRead)
+        {
+            onFrameRead(CPUTextureCache);
+        }
+        Present(CPUTextureCache);
+    }
+
+    // Show a frame that's already on the CPU, either just read back or from somewhere
+    // else entirely (e.g. a recording). frame may be CPUTextureCache itself.
+    virtual void Present(const ImageRGBA& frame) = 0;
+    virtual void Clear() = 0;
+    virtual void Suspend() = 0;
+    virtual void Resume() {}
+    virtual void ProcessEvents() {}
+    virtual bool NeedsEventPolling() { return false; }
+    virtual InputButton* GetInputButton() { return nullptr; }
+
+    // Held while settings change. Config changes are applied on the main thread, so
+    // whoever drives a backend from another thread (see DisplayOutput) holds this
+    // while calling in, and never sees a setting change halfway through a frame.
+    std::mutex settingsMutex;
+
+    // Subscribe to config changes that apply under settingsMutex
+    void subscribeSettings(std::function<void(const ConfigUpdateEventArg&)> handler)
+    {
+        settingsConnections.emplace_back(config.Subscribe([this, handler](const ConfigUpdateEventArg& arg)
+        {
+            std::lock_guard<std::mutex> lock(settingsMutex);
+            handler(arg);
+        }));
+    }
+
+    // Handlers usually touch the subclass's own members, which are gone by the time
+    // this base class is destroyed, so subclasses call this first in their destructor
+    void unsubscribeSettings()
+    {
+        settingsConnections.clear();
+    }
+
+    std::vector<sigslot::scoped_connection> settingsConnections;
+
+    DuplicateFrameFilter duplicateFilter;
+    std::atomic<int> lastFrameRowsWritten{0};
+};
+
+// Reads every frame back like a real display would, then throws it away.
+// For profiling the render path on its own and for headless runs.
+struct NullDisplay : DisplayBackend
+{
+    void Present(const ImageRGBA& frame) override
+    {
+        static std::atomic<uint64_t>& framesWrittenCounter = MetricsService::Counter("display.framesWritten");
+        framesWrittenCounter++;
+    }
+
+    void Clear() override
+    {
+    }
+
+    void Suspend() override
+    {
+    }
+};
+
+static const std::string DEFAULT_SHARED_FRAME_RING_NAME = "/mantlemap-frames";
+static const std::string DEFAULT_SHARED_FRAME_RING_FORMAT = "rgba";
+static const int DEFAULT_SHARED_FRAME_RING_SLOTS = 4;
+
+// Publishes frames into a ring in shared memory for other processes to pick up
+// (see SharedFrameRing.hpp). Only frames that changed are published.
+struct SharedMemoryDisplay : DisplayBackend
+{
+    SharedFrameFormat format;
+    std::unique_ptr<SharedFrameRingWriter> ring;
+
+    SharedMemoryDisplay()
+    {
+        // The ring's layout is fixed once readers can see it, so these only apply at startup
+        std::string name = config.GetConfigValue("sharedFrameRing.name", DEFAULT_SHARED_FRAME_RING_NAME);
+        std::string formatName = config.GetConfigValue("sharedFrameRing.format", DEFAULT_SHARED_FRAME_RING_FORMAT);
+        int slots = config.GetConfigValue("sharedFrameRing.slots", DEFAULT_SHARED_FRAME_RING_SLOTS);
+        format = iequals(formatName, "rgb") ? SharedFrameFormat::RGB8 : SharedFrameFormat::RGBA8;
+        ring = std::make_unique<SharedFrameRingWriter>(name, config.width(), config.height(), format, std::max(slots, 2));
+    }
+
+    void publish(const ImageRGBA& frame)
+    {
+        static std::atomic<uint64_t>& framesWrittenCounter = MetricsService::Counter("display.framesWritten");
+
+        uint8_t* slot = ring->BeginWrite();
+        if (format == SharedFrameFormat::RGBA8)
+        {
+            memcpy(slot, frame.data(), frame.width() * frame.height() * 4);
+        }
+        else
+        {
+            for (int y=0; y < frame.height(); y++)
+            {
+                rgbaToRgbRow(frame.data() + y * frame.width() * 4, slot + y * frame.width() * 3, frame.width());
+            }
+        }
+        ring->EndWrite();
+
+        lastFrameRowsWritten = frame.height();
+        framesWrittenCounter++;
+    }
+
+    void Present(const ImageRGBA& frame) override
+    {
+        static MetricsPhase& publishMetrics = MetricsService::Phase("display.publish");
+
+        if (duplicateFilter.IsDuplicate(frame))
+        {
+            lastFrameRowsWritten = 0;
+            return;
+        }
+
+        MetricsTimer timer(publishMetrics);
+        publish(frame);
+    }
+
+    // Readers see a cleared display as a black frame
+    void Clear() override
+    {
+        memset(CPUTextureCache.data(), 0, CPUTextureCache.width() * CPUTextureCache.height() * 4);
+        publish(CPUTextureCache);
+        duplicateFilter.Invalidate();
+    }
+
+    void Suspend() override
+    {
+        Clear();
+    }
+};
+
+static const int DEFAULT_NET_RENDER_KEYFRAME_INTERVAL = 30;
+
+// How often the net display checks whether a client is due a keyframe
+static const auto NET_RENDER_KEYFRAME_CHECK_INTERVAL = std::chrono::milliseconds(250);
+
+// Streams tiles of each frame to thin clients over UDP (see NetFrameStream.hpp), so one
+// instance can render a wall made of several Pis' panels. The netRender.clients config
+// lists each client as {"address": , "port": , "x": , "y": , "width": , "height": },
+// where x, y, width and height pick out its tile of the frame (all of it by default).
+struct NetRenderDisplay : DisplayBackend
+{
+    std::vector<std::unique_ptr<NetFrameSender>> senders;
+
+    // Keeps keyframes going out while nothing is being rendered
+    std::thread keyframeThread;
+    std::mutex keyframeMutex;
+    std::condition_variable keyframeCondition;
+    bool stopKeyframes = false;
+
+    NetRenderDisplay()
+    {
+        // Clients can't be added while we're streaming, so these only apply at startup
+        int keyframeInterval = config.GetConfigValue("netRender.keyframeInterval", DEFAULT_NET_RENDER_KEYFRAME_INTERVAL);
+        nlohmann::json clients = config.GetConfigValue("netRender.clients", nlohmann::json::array());
+        if (!clients.is_array() || clients.empty())
+        {
+            throw std::runtime_error("The net display needs at least one client in the netRender.clients config!");
+        }
+
+        for (const auto& client : clients)
+        {
+            NetFrameTile tile;
+            tile.address = client.value("address", std::string("127.0.0.1"));
+            tile.port = client.value("port", DEFAULT_NET_FRAME_PORT);
+            tile.x = client.value("x", 0);
+            tile.y = client.value("y", 0);
+            tile.width = client.value("width", config.width() - tile.x);
+            tile.height = client.value("height", config.height() - tile.y);
+            if (tile.x < 0 || tile.y < 0 || tile.width <= 0 || tile.height <= 0 ||
+                tile.x + tile.width > config.width() || tile.y + tile.height > config.height())
+            {
+                throw std::runtime_error(fmt::format("Net client {}'s tile doesn't fit in the {}x{} frame!", tile.address, config.width(), config.height()));
+            }
+
+            senders.push_back(std::make_unique<NetFrameSender>(tile, keyframeInterval));
+            fprintf(stderr, "Streaming the %dx%d tile at (%d, %d) to %s:%d.\n", tile.width, tile.height, tile.x, tile.y, tile.address.c_str(), tile.port);
+        }
+
+        // Scenes that aren't changing don't render, so Present isn't called for them. Clients
+        // would time out and blank, and ones that joined late would never get a keyframe.
+        keyframeThread = std::thread([this]()
+        {
+            ThreadPolicy::Apply("output");
+            std::unique_lock<std::mutex> lock(keyframeMutex);
+            while (!keyframeCondition.wait_for(lock, NET_RENDER_KEYFRAME_CHECK_INTERVAL, [&]() { return stopKeyframes; }))
+            {
+                for (auto& sender : senders)
+                {
+                    sender->SendKeyframeIfDue();
+                }
+            }
+        });
+    }
+
+    ~NetRenderDisplay()
+    {
+        {
+            std::lock_guard<std::mutex> lock(keyframeMutex);
+            stopKeyframes = true;
+        }
+        keyframeCondition.notify_all();
+        keyframeThread.join();
+    }
+
+    // Every frame goes to the senders, which skip tiles that haven't changed themselves
+    // but still send keyframes now and then so clients can recover from lost packets
+    void Present(const ImageRGBA& frame) override
+    {
+        static MetricsPhase& sendMetrics = MetricsService::Phase("display.netSend");
+        static std::atomic<uint64_t>& framesWrittenCounter = MetricsService::Counter("display.framesWritten");
+
+        MetricsTimer timer(sendMetrics);
+        for (auto& sender : senders)
+        {
+            sender->Send(frame);
+        }
+        lastFrameRowsWritten = frame.height();
+        framesWrittenCounter++;
+    }
+
+    // Clients see a cleared display as a black frame
+    void Clear() override
+    {
+        memset(CPUTextureCache.data(), 0, CPUTextureCache.width() * CPUTextureCache.height() * 4);
+        Present(CPUTextureCache);
+    }
+
+    void Suspend() override
+    {
+        Clear();
+    }
+};
+
+#ifdef LED_PANEL_SUPPORT
 
 #include "EGL/egl.h"
 #include "GLES2/gl2.h"
@@ -15,103 +359,544 @@ static auto& config = ConfigService::global;
 #include "pixel-mapper.h"
 #include "content-streamer.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 using rgb_matrix::Canvas;
 using rgb_matrix::FrameCanvas;
 using rgb_matrix::RGBMatrix;
 using rgb_matrix::StreamReader;
 
-struct DisplayDevice::Impl
+static const bool DEFAULT_ROW_DELTA_UPDATES = true;
+static const int DEFAULT_PWM_BITS = 6;
+static const bool DEFAULT_POST_PROCESS = false;
+static const int DEFAULT_GPIO_SLOWDOWN = 2;
+static const int DEFAULT_READBACK_BAND_ROWS = 0;
+static const int DEFAULT_CONVERT_THREADS = 2;
+static const std::string DEFAULT_HARDWARE_MAPPING = "regular";
+
+// What the matrix library's refresh thread is called (see createMatrix)
+static const std::string PANEL_THREAD_NAME = "led-panel";
+
+// What one of the panel's canvases holds, so rows that haven't changed since
+// it was last drawn into can be skipped. SwapOnVSync hands back the canvas that
+// was on screen, which is a frame behind, so each canvas needs its own copy.
+struct CanvasShadow
 {
-    RGBMatrix* matrix;
-    FrameCanvas* offscreen_canvas;
-    ImageRGBA CPUTextureCache;
+    FrameCanvas* canvas;
+    ImageRGBA contents;
+    bool valid;
+};
+
+struct LedPanelDisplay : DisplayBackend
+{
+    RGBMatrix* matrix = nullptr;
+    FrameCanvas* offscreen_canvas = nullptr;
+
+    // The panels' native buffer. When the layout isn't the logical frame as is,
+    // frames are remapped into it (on the GPU where we can) before they get here.
+    PanelLayout layout;
+    bool remapped;
+    ImageRGBA layoutLookup;
+    ImageRGBA remappedFrame;
+    int width;
+    int height;
+
+    bool rowDeltaUpdates = DEFAULT_ROW_DELTA_UPDATES;
+    int pwmBits = DEFAULT_PWM_BITS;
+
+    // The render context's post process pass already applies gamma and quantizes to
+    // pwmBits, so the panel library's own luminance correction has to stay out of the way
+    bool postProcessed = DEFAULT_POST_PROCESS;
+    std::vector<CanvasShadow> canvasShadows;
+
+    // When the render pipeline is deeper than one frame, converting and presenting
+    // frames happens on a present thread so it overlaps with rendering the next one.
+    // Readback hands frames over through a single slot; if the present thread falls
+    // behind, the newest frame replaces the one still waiting.
+    int pipelineDepth = DEFAULT_PIPELINE_DEPTH;
+    std::unique_ptr<std::thread> presentThread;
+    std::mutex presentMutex;
+    std::condition_variable presentCondition;
+    ImageRGBA pendingFrame;
+    ImageRGBA presentFrame;
+    bool framePending = false;
+    bool clearPending = false;
+    bool stopPresenting = false;
+
+    // rowDeltaUpdates as of when the pending frame was submitted. Settings only change
+    // where frames are submitted from, so the present thread gets them with each frame.
+    bool pendingRowDeltaUpdates = DEFAULT_ROW_DELTA_UPDATES;
+
+    // With ledPanel.readbackBandRows set, frames are read back that many rows at a time
+    // and each band is converted on ledPanel.convertThreads workers while the next is
+    // read. That takes the place of the present thread. Not used when remapping.
+    // The trade-off: the render thread waits until every row is converted, so with
+    // renderPipelineDepth above 1 the next frame is no longer drawn while this one is
+    // presented. Banding wins when conversion is the bottleneck and spare cores can share
+    // it; a present thread wins when drawing is. The workers run as the "convert" thread
+    // class (see ThreadPolicy.hpp), which wants as many CPUs as there are workers.
+    int readbackBandRows = DEFAULT_READBACK_BAND_ROWS;
+    int convertThreads = DEFAULT_CONVERT_THREADS;
+    std::unique_ptr<BandedReadback> bandedReadback;
+    std::vector<int> workerRowsWritten;
+
+    // Deep sleep closes and reopens the panel, which needs root to stick around.
+    // Privileges can't be got back once dropped, so this is only read at startup.
+    bool keepPrivileges;
+
+    LedPanelDisplay() : 
+        layout(PanelLayout::FromConfig()),
+        remapped(!layout.IsIdentity()),
+        width(layout.NativeWidth()),
+        height(layout.NativeHeight()),
+        pendingFrame(width, height),
+        presentFrame(width, height),
+        keepPrivileges(config.GetConfigValue("deepSleep", false))
+    {
+        if (remapped)
+        {
+            layoutLookup = layout.BuildLookup();
+            remappedFrame = ImageRGBA(width, height);
+            fprintf(stderr, "LED panels are %dx%d natively, remapping frames to fit.\n", width, height);
+        }
+
+        // As the main display this all happens on the main thread. As an extra output,
+        // Present() runs on a bus thread and holds settingsMutex (see DisplayOutput).
+        subscribeSettings([&](const ConfigUpdateEventArg& arg)
+        {
+            arg.UpdateIfChanged("renderPipelineDepth", pipelineDepth, DEFAULT_PIPELINE_DEPTH);
+            arg.UpdateIfChanged("rowDeltaUpdates", rowDeltaUpdates, DEFAULT_ROW_DELTA_UPDATES);
+            arg.UpdateIfChanged("ledPanel.readbackBandRows", readbackBandRows, DEFAULT_READBACK_BAND_ROWS);
+            if (arg.UpdateIfChanged("ledPanel.convertThreads", convertThreads, DEFAULT_CONVERT_THREADS))
+            {
+                // Started again with the new count next time it's needed
+                bandedReadback = nullptr;
+            }
+
+            if (arg.UpdateIfChanged("ledPanel.pwmBits", pwmBits, DEFAULT_PWM_BITS) && matrix != nullptr)
+            {
+                matrix->SetPWMBits(pwmBits);
+            }
+
+            if (arg.UpdateIfChanged("postProcess.enabled", postProcessed, DEFAULT_POST_PROCESS) && matrix != nullptr)
+            {
+                matrix->set_luminance_correct(!postProcessed);
+            }
+        });
 
-    Impl() : CPUTextureCache(config.width(), config.height())
+        createMatrix();
+    }
+
+    ~LedPanelDisplay()
     {
-        // Config parameters
-        int cols = 64;
-        int rows = 32;
-        int chainLength = 3;
-        int parallelLength = 3;
-        int slowdown = 2;
+        unsubscribeSettings();
+        stopPresentThread();
+        destroyMatrix();
+    }
+
+    void createMatrix()
+    {
+        // Config parameters. Any pixel mapping is already done by the time frames
+        // get here, so the library's own pixel mappers stay off.
+        static const std::string hardwareMapping = config.GetConfigValue("ledPanel.hardwareMapping", DEFAULT_HARDWARE_MAPPING);
+        int slowdown = config.GetConfigValue("ledPanel.slowdown", DEFAULT_GPIO_SLOWDOWN);
         
         // Move params into structures
         RGBMatrix::Options matrixParams;
-        //std::string hardware_mapping = "regular";
-        matrixParams.rows = rows;
-        matrixParams.cols = cols;
-        matrixParams.chain_length = chainLength;
-        matrixParams.hardware_mapping = "regular";
-        matrixParams.parallel = parallelLength;
+        matrixParams.rows = layout.Rows();
+        matrixParams.cols = layout.Cols();
+        matrixParams.chain_length = layout.ChainLength();
+        matrixParams.hardware_mapping = hardwareMapping.c_str();
+        matrixParams.parallel = layout.Parallel();
         matrixParams.pwm_lsb_nanoseconds = 200;
         matrixParams.brightness = 100;
-        matrixParams.pwm_bits = 6;
+        matrixParams.pwm_bits = pwmBits;
         rgb_matrix::RuntimeOptions runtimeParams;
         runtimeParams.do_gpio_init = true;
         runtimeParams.gpio_slowdown = slowdown;
 
-        // Prepare matrix
+        if (keepPrivileges)
+        {
+            runtimeParams.drop_privileges = 0;
+        }
+
+        // Prepare matrix. Its refresh thread is the library's own, so find it by
+        // which thread appeared while the matrix started. Other threads can start
+        // meanwhile too, so we take on a name for the refresh thread to inherit
+        // that nothing started elsewhere could have.
+        pid_t self = ThreadPolicy::CurrentThread();
+        std::string ourName = ThreadPolicy::ThreadName(self);
+        std::vector<pid_t> threadsBefore = ThreadPolicy::ProcessThreads();
+        ThreadPolicy::SetThreadName(self, PANEL_THREAD_NAME);
         matrix = CreateMatrixFromOptions(matrixParams, runtimeParams);
+        ThreadPolicy::SetThreadName(self, ourName);
         if (matrix == nullptr)
         {
             throw std::runtime_error("LED display init failed!");
         }
+        for (pid_t tid : ThreadPolicy::ProcessThreads())
+        {
+            if (!std::binary_search(threadsBefore.begin(), threadsBefore.end(), tid) &&
+                ThreadPolicy::ThreadName(tid) == PANEL_THREAD_NAME)
+            {
+                ThreadPolicy::ApplyToThread("panel", tid);
+            }
+        }
         
+        matrix->set_luminance_correct(!postProcessed);
+
         // Create our double buffering canvas
         offscreen_canvas = matrix->CreateFrameCanvas();
     }
 
-    ~Impl()
+    void destroyMatrix()
     {
+        if (matrix == nullptr)
+            return;
+
+        // Deleting the matrix stops its refresh thread
         matrix->Clear();
         delete matrix;
+        matrix = nullptr;
+        offscreen_canvas = nullptr;
+        canvasShadows.clear();
+        duplicateFilter.Invalidate();
+    }
+
+    CanvasShadow& shadowFor(FrameCanvas* canvas)
+    {
+        for (CanvasShadow& shadow : canvasShadows)
+        {
+            if (shadow.canvas == canvas)
+                return shadow;
+        }
+        canvasShadows.push_back({canvas, ImageRGBA(width, height), false});
+        return canvasShadows.back();
+    }
+
+    void Suspend() override
+    {
+        stopPresentThread();
+        destroyMatrix();
+    }
+
+    void Resume() override
+    {
+        if (matrix == nullptr)
+        {
+            createMatrix();
+        }
+    }
+
+    void startPresentThread()
+    {
+        stopPresenting = false;
+        framePending = false;
+        clearPending = false;
+        presentThread = std::make_unique<std::thread>([this]()
+        {
+            ThreadPolicy::Apply("present");
+            presentLoop();
+        });
     }
 
-    void DrawFromGLFramebuffer()
+    void stopPresentThread()
     {
-        // Copy out to CPU
-        glReadPixels(0,0, config.width(), config.height(), GL_RGBA, GL_UNSIGNED_BYTE,  CPUTextureCache.data());
+        if (presentThread == nullptr)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(presentMutex);
+            stopPresenting = true;
+        }
+        presentCondition.notify_all();
+        presentThread->join();
+        presentThread = nullptr;
+    }
+
+    void presentLoop()
+    {
+        std::unique_lock<std::mutex> lock(presentMutex);
+        while (true)
+        {
+            presentCondition.wait(lock, [&]() { return framePending || clearPending || stopPresenting; });
+            if (stopPresenting)
+                break;
+
+            if (clearPending)
+            {
+                clearPending = false;
+                lock.unlock();
+                clear();
+                lock.lock();
+                continue;
+            }
+
+            std::swap(pendingFrame, presentFrame);
+            framePending = false;
+            bool rowDeltas = pendingRowDeltaUpdates;
+
+            lock.unlock();
+            present(presentFrame, rowDeltas);
+            lock.lock();
+        }
+    }
+
+    // Convert a frame into the offscreen canvas and swap it onto the panel.
+    // rowDeltas is the rowDeltaUpdates setting, snapshotted by whoever submitted the frame.
+    void present(const ImageRGBA& frame, bool rowDeltas)
+    {
+        // If nothing changed, the panel is already showing this frame
+        if (duplicateFilter.IsDuplicate(frame))
+            return;
         
-        // Copy into offscreen LED Matrix buffer
-        uint8_t* img =  CPUTextureCache.data();
-        for (int y=0; y < config.height(); y++)
+        static MetricsPhase& convertMetrics = MetricsService::Phase("display.convert");
+        static MetricsPhase& swapMetrics = MetricsService::Phase("display.swap");
+        static std::atomic<uint64_t>& rowsWrittenCounter = MetricsService::Counter("display.rowsWritten");
+        static std::atomic<uint64_t>& framesWrittenCounter = MetricsService::Counter("display.framesWritten");
+
+        // Copy into offscreen LED Matrix buffer. Frames are read back top row first
+        // (see GfxProgram::setCameraFromPixelTransform), so rows go straight across.
+        // Only rows that differ from what this canvas already holds are written.
         {
-            for (int x=0; x < config.width(); x++)
+            MetricsTimer timer(convertMetrics);
+            CanvasShadow& shadow = shadowFor(offscreen_canvas);
+            bool skipUnchanged = rowDeltas && shadow.valid;
+            int rowsWritten = 0;
+            for (int y=0; y < height; y++)
             {
-                offscreen_canvas->SetPixel(x, (config.height()-1)-y, img[0],img[1], img[2]);
-                img += 4;
+                if (convertRow(frame, shadow, skipUnchanged, y))
+                {
+                    rowsWritten++;
+                }
             }
+            shadow.valid = true;
+
+            lastFrameRowsWritten = rowsWritten;
+            rowsWrittenCounter += rowsWritten;
+            framesWrittenCounter++;
         }
 
+        MetricsTimer timer(swapMetrics);
         offscreen_canvas = matrix->SwapOnVSync(offscreen_canvas);
     }
-};
 
-DisplayDevice::DisplayDevice()
-{
-    pImpl_ = std::make_unique<Impl>();
-}
+    // Write one row of frame into the offscreen canvas, unless it's already there.
+    // Returns true if it was written. The library only takes pixels one at a time
+    // through SetPixel, which does its own bit plane packing per pixel, so there's no
+    // bulk write to feed a vectorized conversion into. What's vectorized here is the
+    // check for an unchanged row; the rest reads straight from the RGBA row.
+    bool convertRow(const ImageRGBA& frame, CanvasShadow& shadow, bool skipUnchanged, int y)
+    {
+        size_t rowBytes = width * 4;
+        const uint8_t* img = frame.data() + y * rowBytes;
+        uint8_t* shadowRow = shadow.contents.data() + y * rowBytes;
+        if (skipUnchanged && pixelRowsEqual(img, shadowRow, rowBytes))
+            return false;
 
-DisplayDevice::~DisplayDevice()
-{
-}
+        const uint8_t* rgba = img;
+        for (int x=0; x < width; x++)
+        {
+            offscreen_canvas->SetPixel(x, y, rgba[0], rgba[1], rgba[2]);
+            rgba += 4;
+        }
+        memcpy(shadowRow, img, rowBytes);
+        return true;
+    }
 
-void DisplayDevice::Update()
-{
-	pImpl_->DrawFromGLFramebuffer();
-}
+    // Read the frame back in bands, converting each one into the offscreen canvas on
+    // the workers while the next is read, then swap it onto the panel
+    void updateBanded(GLRenderContext& render)
+    {
+        static MetricsPhase& bandedMetrics = MetricsService::Phase("display.bandedReadback");
+        static MetricsPhase& swapMetrics = MetricsService::Phase("display.swap");
+        static std::atomic<uint64_t>& rowsWrittenCounter = MetricsService::Counter("display.rowsWritten");
+        static std::atomic<uint64_t>& framesWrittenCounter = MetricsService::Counter("display.framesWritten");
 
-void DisplayDevice::Clear()
-{
-    pImpl_->matrix->Clear();
-}
+        // The workers do the present thread's job
+        stopPresentThread();
+        if (bandedReadback == nullptr)
+        {
+            bandedReadback = std::make_unique<BandedReadback>(convertThreads);
+        }
+        workerRowsWritten.assign(bandedReadback->Workers(), 0);
 
-InputButton* DisplayDevice::GetInputButton()
-{
-    return nullptr;
-}
+        // Settings change on the main thread, which is the one reading back here,
+        // so this can't change mid-frame. Take it once all the same, as present() does.
+        bool rowDeltas = rowDeltaUpdates;
+
+        CanvasShadow& shadow = shadowFor(offscreen_canvas);
+        bool skipUnchanged = rowDeltas && shadow.valid;
+        {
+            MetricsTimer timer(bandedMetrics);
+            bool read = bandedReadback->Read(render, CPUTextureCache, readbackBandRows, [&](int worker, int y)
+            {
+                if (convertRow(CPUTextureCache, shadow, skipUnchanged, y))
+                {
+                    workerRowsWritten[worker]++;
+                }
+            });
+            if (!read)
+                return;
+        }
+        shadow.valid = true;
+
+        if (onFrameRead)
+        {
+            onFrameRead(CPUTextureCache);
+        }
+
+        // The canvas now holds this frame either way, but there's no need to swap
+        // if the panel's already showing it
+        if (duplicateFilter.IsDuplicate(CPUTextureCache))
+        {
+            lastFrameRowsWritten = 0;
+            return;
+        }
+
+        int rowsWritten = 0;
+        for (int rows : workerRowsWritten)
+        {
+            rowsWritten += rows;
+        }
+        lastFrameRowsWritten = rowsWritten;
+        rowsWrittenCounter += rowsWritten;
+        framesWrittenCounter++;
+
+        MetricsTimer timer(swapMetrics);
+        offscreen_canvas = matrix->SwapOnVSync(offscreen_canvas);
+    }
+
+    void clear()
+    {
+        matrix->Clear();
+        duplicateFilter.Invalidate();
+
+        // We don't know which canvases Clear touched, so rewrite everything next time
+        for (CanvasShadow& shadow : canvasShadows)
+        {
+            shadow.valid = false;
+        }
+    }
+
+    void Update(GLRenderContext& render) override
+    {
+        // Don't bother reading back frames nobody will see
+        if (matrix == nullptr)
+            return;
+
+        if (!remapped && readbackBandRows > 0)
+        {
+            updateBanded(render);
+            return;
+        }
+
+        if (!remapped)
+        {
+            DisplayBackend::Update(render);
+            return;
+        }
+
+        // The logical frame only comes back to the CPU if someone else wants it
+        static MetricsPhase& readMetrics = MetricsService::Phase("display.readback");
+        if (frameWanted && frameWanted() && onFrameRead)
+        {
+            MetricsTimer timer(readMetrics);
+            if (render.ReadFrame(CPUTextureCache))
+            {
+                onFrameRead(CPUTextureCache);
+            }
+        }
+
+        static MetricsPhase& remapMetrics = MetricsService::Phase("display.remap");
+        {
+            MetricsTimer timer(remapMetrics);
+            if (!render.ReadFrameRemapped(layoutLookup, remappedFrame))
+                return;
+        }
+        submit(remappedFrame);
+    }
+
+    void Present(const ImageRGBA& frame) override
+    {
+        if (matrix == nullptr)
+            return;
+
+        if (remapped)
+        {
+            layout.Remap(frame, remappedFrame);
+            submit(remappedFrame);
+        }
+        else
+        {
+            submit(frame);
+        }
+    }
+
+    // Show a frame that's already in the panels' native layout
+    void submit(const ImageRGBA& frame)
+    {
+        bool pipelined = GLRenderContext::ClampPipelineDepth(pipelineDepth) > 1;
+        if (pipelined && presentThread == nullptr)
+        {
+            startPresentThread();
+        }
+        else if (!pipelined && presentThread != nullptr)
+        {
+            stopPresentThread();
+        }
+
+        // This runs on the main thread, or with settingsMutex held as an extra output,
+        // so the settings can be read here and passed on to the present thread
+        if (!pipelined)
+        {
+            present(frame, rowDeltaUpdates);
+            return;
+        }
+
+        // The hand-off below swaps buffers, so frames from elsewhere get copied in first
+        ImageRGBA& staging = remapped ? remappedFrame : CPUTextureCache;
+        if (&frame != &staging)
+        {
+            memcpy(staging.data(), frame.data(), width * height * 4);
+        }
+
+        // Hand the frame to the present thread and keep its old buffer for the next readback
+        {
+            std::lock_guard<std::mutex> lock(presentMutex);
+            std::swap(staging, pendingFrame);
+            framePending = true;
+            pendingRowDeltaUpdates = rowDeltaUpdates;
+        }
+        presentCondition.notify_one();
+    }
+
+    void Clear() override
+    {
+        if (matrix == nullptr)
+            return;
+
+        if (presentThread == nullptr)
+        {
+            clear();
+            return;
+        }
+
+        // Drop whatever's waiting and let the present thread clear once it's done with the current frame
+        {
+            std::lock_guard<std::mutex> lock(presentMutex);
+            framePending = false;
+            clearPending = true;
+        }
+        presentCondition.notify_one();
+    }
+};
 
 #else
+
 #include "EGL/egl.h"
 #include "EGL/eglplatform.h"
 #include "GLES2/gl2.h"
@@ -119,7 +904,6 @@ InputButton* DisplayDevice::GetInputButton()
 
 #include "GfxProgram.hpp"
 #include "GfxTexture.hpp"
-#include "ImageRGBA.hpp"
 
 #include <util/OSWindow.h>
 #include <thread>
@@ -141,23 +925,36 @@ static const EGLint context_attributes[] =
     EGL_NONE
 };
 
-// This display device opens an OS native window and renders a preview to the display
-struct DisplayDevice::Impl : public InputButton
+// Contexts sharing the render context's textures have to match its version
+static const EGLint context_attributes_es3[] = 
 {
+    EGL_CONTEXT_CLIENT_VERSION, 3,
+    EGL_NONE
+};
+
+static const bool DEFAULT_SIMULATOR_SHARED_CONTEXT = true;
+
+// This display device opens an OS native window and renders a preview to the display.
+// When it can share the render context's textures it draws each frame straight
+// from the GPU, otherwise frames make the trip through the CPU like on the LED panel.
+struct WindowDisplay : DisplayBackend, InputButton
+{
+    sigslot::signal<>& onDisconnect;
     OSWindow* window;
     bool running = true;
     EGLSurface surface;
     EGLDisplay display;
     EGLConfig glConfig;
     EGLContext context;
-    ImageRGBA CPUTextureCache;
+    EGLContext sharedContext = EGL_NO_CONTEXT;
     std::unique_ptr<GfxProgram> program;
     std::unique_ptr<GfxTexture> texture;
     GLint vertexAttrib;
     GLint coordinateAttrib;
     std::vector<float> mesh;
 
-    Impl() : CPUTextureCache(config.width(), config.height())
+    WindowDisplay(sigslot::signal<>& onDisconnect, GLRenderContext* render) : 
+        onDisconnect(onDisconnect)
     {
         // Create the OS window
         window = OSWindow::New();
@@ -185,8 +982,28 @@ struct DisplayDevice::Impl : public InputButton
             throw std::runtime_error("Couldn't create surface!");
         }
 
-        // Create an OpenGL rendering context
-        context = eglCreateContext(display, glConfig, EGL_NO_CONTEXT, context_attributes);
+        // Create an OpenGL rendering context, sharing textures with the render context if we can.
+        // Contexts can only share on the same EGL display.
+        context = EGL_NO_CONTEXT;
+        bool shareContext = config.GetConfigValue("simulatorSharedContext", DEFAULT_SIMULATOR_SHARED_CONTEXT);
+        if (shareContext && render != nullptr && render->GetEGLDisplay() == display)
+        {
+            const EGLint* attributes = render->GetGLESVersion() >= 3 ? context_attributes_es3 : context_attributes;
+            context = eglCreateContext(display, glConfig, render->GetEGLContext(), attributes);
+            if (context != EGL_NO_CONTEXT)
+            {
+                sharedContext = render->GetEGLContext();
+            }
+        }
+        if (shareContext && sharedContext == EGL_NO_CONTEXT)
+        {
+            fprintf(stderr, "Couldn't share the render context with the simulator window, copying frames through the CPU instead.\n");
+        }
+
+        if (context == EGL_NO_CONTEXT)
+        {
+            context = eglCreateContext(display, glConfig, EGL_NO_CONTEXT, context_attributes);
+        }
         if (context == EGL_NO_CONTEXT)
         {
             throw std::runtime_error("Couldn't create context!");
@@ -218,7 +1035,7 @@ struct DisplayDevice::Impl : public InputButton
         print_if_glerror("Creating mesh for emulated display");
     }
 
-    void processEvents(sigslot::signal<>& diconnectEvent)
+    void ProcessEvents() override
     {
         window->messageLoop();
         Event event;
@@ -226,14 +1043,14 @@ struct DisplayDevice::Impl : public InputButton
         {
             if (event.Type == Event::EVENT_CLOSED)
             {
-                diconnectEvent();
+                onDisconnect();
             }
             else if (event.Type == Event::EVENT_KEY_PRESSED)
             {
                 switch (event.Key.Code)
                 {
                     case KEY_ESCAPE:
-                        diconnectEvent();
+                        onDisconnect();
                         break;
                     case KEY_SPACE:
                         OnTap();
@@ -245,16 +1062,78 @@ struct DisplayDevice::Impl : public InputButton
         }
     }
 
-    void update()
+    bool NeedsEventPolling() override
+    {
+        // Window events only show up when we pump the message loop
+        return true;
+    }
+
+    InputButton* GetInputButton() override
+    {
+        return this;
+    }
+
+    void Update(GLRenderContext& render) override
+    {
+        // Without a shared context, or once deep sleep has replaced the render
+        // context with one we don't share, frames have to come through the CPU
+        if (sharedContext == EGL_NO_CONTEXT || render.GetEGLContext() != sharedContext)
+        {
+            DisplayBackend::Update(render);
+            return;
+        }
+
+        GLuint frameTexture = render.GetFrameTexture();
+        if (frameTexture == 0)
+            return;
+
+        // Only read frames back when someone else is asking for them
+        if (frameWanted && frameWanted())
+        {
+            static MetricsPhase& readMetrics = MetricsService::Phase("display.readback");
+            MetricsTimer timer(readMetrics);
+            if (render.ReadFrame(CPUTextureCache) && onFrameRead)
+            {
+                onFrameRead(CPUTextureCache);
+            }
+        }
+
+        ProcessEvents();
+        eglMakeCurrent(display, surface, surface, context);
+        lastFrameRowsWritten = config.height();
+        draw(frameTexture);
+    }
+
+    void Present(const ImageRGBA& frame) override
     {
-        // Copy out render to CPU
-        glReadPixels(0,0, config.width(), config.height(), GL_RGBA, GL_UNSIGNED_BYTE,  CPUTextureCache.data());
+        ProcessEvents();
+
+        static MetricsPhase& uploadMetrics = MetricsService::Phase("display.upload");
 
         // Switch contexts to this display
         eglMakeCurrent(display, surface, surface, context);
 
-        // Push the new render into the texture
-        texture->LoadImageToTexture(CPUTextureCache);
+        // Push the new render into the texture, unless it's the one already there.
+        // We still redraw the window since it may have been resized or exposed.
+        // The texture is always uploaded whole
+        if (!duplicateFilter.IsDuplicate(frame))
+        {
+            MetricsTimer timer(uploadMetrics);
+            texture->LoadImageToTexture(frame);
+            lastFrameRowsWritten = config.height();
+        }
+        else
+        {
+            lastFrameRowsWritten = 0;
+        }
+
+        draw(texture->GetId());
+    }
+
+    // Draw a frame texture into the window with the LED look and show it
+    void draw(GLuint frameTexture)
+    {
+        static MetricsPhase& swapMetrics = MetricsService::Phase("display.swap");
 
         // Set the viewport
         float winRatio = (float)window->getWidth() /  (float)window->getHeight();
@@ -279,6 +1158,7 @@ struct DisplayDevice::Impl : public InputButton
         // Draw the image
         program->Use();
         glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, frameTexture);
 
         // Tell our shader which units to look for each texture on
         program->SetUniform("uTexture", 0);
@@ -311,10 +1191,24 @@ struct DisplayDevice::Impl : public InputButton
         // Draw the triangles!
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-
+        MetricsTimer timer(swapMetrics);
         eglSwapBuffers(display, surface);
     }
 
+    void Clear() override
+    {
+        ProcessEvents();
+        clear();
+        duplicateFilter.Invalidate();
+    }
+
+    void Suspend() override
+    {
+        // Just leave the window showing the cleared screen
+        ProcessEvents();
+        clear();
+    }
+
     void clear()
     {
         // Switch contexts to this display
@@ -326,7 +1220,7 @@ struct DisplayDevice::Impl : public InputButton
         eglSwapBuffers(display, surface);
     }
 
-    ~Impl()
+    ~WindowDisplay()
     {
         running = false;
         if (window != nullptr && window->valid())
@@ -334,30 +1228,281 @@ struct DisplayDevice::Impl : public InputButton
     }
 };
 
-DisplayDevice::DisplayDevice() 
+#endif
+
+#ifdef LED_PANEL_SUPPORT
+static const std::string DEFAULT_DISPLAY_BACKEND = "led";
+#else
+static const std::string DEFAULT_DISPLAY_BACKEND = "window";
+#endif
+
+static std::unique_ptr<DisplayBackend> createBackend(const std::string& name, sigslot::signal<>& onDisconnect, GLRenderContext* render);
+
+static const std::string DEFAULT_RECORDING_PATH = "mantlemap.mmrec";
+static const int DEFAULT_RECORDING_KEYFRAME_INTERVAL = 60;
+static const std::string DEFAULT_RECORDING_DISPLAY = "null";
+
+// Records every changed frame to a file (see FrameRecording.hpp) and passes
+// it on to another display, so a session can be replayed later with --replay
+struct RecordingDisplay : DisplayBackend
+{
+    std::unique_ptr<DisplayBackend> inner;
+    std::unique_ptr<FrameRecorder> recorder;
+    std::string path;
+
+    RecordingDisplay(sigslot::signal<>& onDisconnect)
+    {
+        path = config.GetConfigValue("recording.path", DEFAULT_RECORDING_PATH);
+        int keyframeInterval = config.GetConfigValue("recording.keyframeInterval", DEFAULT_RECORDING_KEYFRAME_INTERVAL);
+        std::string innerName = config.GetConfigValue("recording.display", DEFAULT_RECORDING_DISPLAY);
+        if (iequals(innerName, "auto"))
+        {
+            innerName = DEFAULT_DISPLAY_BACKEND;
+        }
+        if (iequals(innerName, "record"))
+        {
+            throw std::runtime_error("The recording display can't pass frames on to itself!");
+        }
+
+        // Frames reach the inner display through Present, so it gets no render context
+        inner = createBackend(innerName, onDisconnect, nullptr);
+        recorder = std::make_unique<FrameRecorder>(path, config.width(), config.height(), keyframeInterval);
+        fprintf(stderr, "Recording frames to %s, shown on %s.\n", path.c_str(), innerName.c_str());
+    }
+
+    ~RecordingDisplay()
+    {
+        fprintf(stderr, "Recorded %llu frames (%llu bytes) to %s.\n",
+                (unsigned long long)recorder->FramesWritten(), (unsigned long long)recorder->BytesWritten(), path.c_str());
+    }
+
+    void Present(const ImageRGBA& frame) override
+    {
+        static MetricsPhase& recordMetrics = MetricsService::Phase("display.record");
+
+        // Duplicates aren't recorded; replay holds the last frame until the next one's timestamp
+        if (!duplicateFilter.IsDuplicate(frame))
+        {
+            MetricsTimer timer(recordMetrics);
+            recorder->Write(frame, FrameClock::now());
+        }
+
+        // This may be an extra output, so the inner display's settings get the same protection
+        std::lock_guard<std::mutex> lock(inner->settingsMutex);
+        inner->Present(frame);
+        lastFrameRowsWritten = inner->lastFrameRowsWritten.load();
+    }
+
+    void Clear() override
+    {
+        duplicateFilter.Invalidate();
+        std::lock_guard<std::mutex> lock(inner->settingsMutex);
+        inner->Clear();
+    }
+
+    void Suspend() override
+    {
+        duplicateFilter.Invalidate();
+        std::lock_guard<std::mutex> lock(inner->settingsMutex);
+        inner->Suspend();
+    }
+
+    void Resume() override
+    {
+        std::lock_guard<std::mutex> lock(inner->settingsMutex);
+        inner->Resume();
+    }
+
+    void ProcessEvents() override
+    {
+        inner->ProcessEvents();
+    }
+
+    bool NeedsEventPolling() override
+    {
+        return inner->NeedsEventPolling();
+    }
+
+    InputButton* GetInputButton() override
+    {
+        return inner->GetInputButton();
+    }
+};
+
+static std::unique_ptr<DisplayBackend> createBackend(const std::string& name, sigslot::signal<>& onDisconnect, GLRenderContext* render)
+{
+    if (iequals(name, "null"))
+    {
+        return std::make_unique<NullDisplay>();
+    }
+    else if (iequals(name, "shm"))
+    {
+        return std::make_unique<SharedMemoryDisplay>();
+    }
+    else if (iequals(name, "record"))
+    {
+        return std::make_unique<RecordingDisplay>(onDisconnect);
+    }
+    else if (iequals(name, "net"))
+    {
+        return std::make_unique<NetRenderDisplay>();
+    }
+#ifdef LED_PANEL_SUPPORT
+    else if (iequals(name, "led"))
+    {
+        return std::make_unique<LedPanelDisplay>();
+    }
+#else
+    else if (iequals(name, "window"))
+    {
+        return std::make_unique<WindowDisplay>(onDisconnect, render);
+    }
+#endif
+
+    throw std::runtime_error(fmt::format("Display backend {} isn't available in this build (try {}, shm, record, net or null).", name, DEFAULT_DISPLAY_BACKEND));
+}
+
+// An extra display fed from the frame bus on its own thread, so it can't hold up the main one.
+// Its settings still change on the main thread, so every call in holds its settingsMutex.
+struct DisplayOutput
+{
+    std::unique_ptr<DisplayBackend> backend;
+    std::unique_ptr<FrameSubscription> subscription;
+
+    DisplayOutput(const std::string& name, FrameBus& frames, sigslot::signal<>& onDisconnect)
+    {
+        // Frames arrive through Present, off the main thread, so it gets no render context
+        backend = createBackend(name, onDisconnect, nullptr);
+
+        DisplayBackend* target = backend.get();
+        subscription = frames.Subscribe(fmt::format("display.{}", name), FrameSubscriberOptions(),
+            [target](const SharedFrame& frame, FrameTimePoint time)
+            {
+                std::lock_guard<std::mutex> lock(target->settingsMutex);
+                target->Present(*frame);
+            });
+    }
+
+    // Outputs can be torn down while the process carries on (a bench or replay's
+    // DisplayDevice, a failed setup), so nothing may be left pointing at the backend.
+    // Frames stop first, then the backend drops its config subscriptions as it goes.
+    ~DisplayOutput()
+    {
+        subscription.reset();
+        backend.reset();
+    }
+
+    // Sleep along with the main display, e.g. so an LED output lets go of its panel too
+    void Suspend()
+    {
+        std::lock_guard<std::mutex> lock(backend->settingsMutex);
+        backend->Suspend();
+    }
+
+    void Resume()
+    {
+        std::lock_guard<std::mutex> lock(backend->settingsMutex);
+        backend->Resume();
+    }
+};
+
+DisplayDevice::DisplayDevice(const std::string& backend, GLRenderContext* render) :
+    frames_(config.width(), config.height())
+{
+    backendName_ = iequals(backend, "auto") ? DEFAULT_DISPLAY_BACKEND : backend;
+    pImpl_ = createBackend(backendName_, OnDisconnect, render);
+    pImpl_->onFrameRead = [this](const ImageRGBA& frame) { frames_.Publish(frame); };
+    pImpl_->frameWanted = [this]() { return frames_.Wanted(); };
+
+    fprintf(stderr, "Display backend is %s.\n", backendName_.c_str());
+
+    // Outputs are set up once, so changes to the list apply at the next start
+    nlohmann::json outputNames = config.GetConfigValue("displayOutputs", nlohmann::json::array());
+    if (outputNames.is_array())
+    {
+        for (const auto& entry : outputNames)
+        {
+            std::string name = entry.is_string() ? entry.get<std::string>() : "";
+            if (iequals(name, "auto") || iequals(name, "window") || iequals(name, backendName_))
+            {
+                throw std::runtime_error(fmt::format("{} can't be an extra display output (try shm, record, net or null).", name));
+            }
+            outputs_.push_back(std::make_unique<DisplayOutput>(name, frames_, OnDisconnect));
+            fprintf(stderr, "Also displaying frames on %s.\n", name.c_str());
+        }
+    }
+}
+
+DisplayDevice::~DisplayDevice()
+{
+}
+
+void DisplayDevice::Update(GLRenderContext& render)
+{
+    pImpl_->Update(render);
+}
+
+void DisplayDevice::Update(const ImageRGBA& frame)
+{
+    frames_.Publish(frame);
+    pImpl_->Present(frame);
+}
+
+void DisplayDevice::Clear()
 {
-    pImpl_ = std::make_unique<Impl>();
+    frames_.PublishBlank();
+    pImpl_->Clear();
 }
 
-DisplayDevice::~DisplayDevice() 
+void DisplayDevice::Suspend()
 {
+    pImpl_->Suspend();
+    for (auto& output : outputs_)
+    {
+        output->Suspend();
+    }
+}
+
+void DisplayDevice::Resume()
+{
+    pImpl_->Resume();
+    for (auto& output : outputs_)
+    {
+        output->Resume();
+    }
+}
+
+void DisplayDevice::ProcessEvents()
+{
+    pImpl_->ProcessEvents();
+}
+
+bool DisplayDevice::NeedsEventPolling()
+{
+    return pImpl_->NeedsEventPolling();
 }
 
 InputButton* DisplayDevice::GetInputButton()
 {
-    return pImpl_.get();
+    return pImpl_->GetInputButton();
 }
 
-void DisplayDevice::Update() 
+uint64_t DisplayDevice::GetSuppressedFrameCount()
 {
-    pImpl_->processEvents(OnDisconnect);
-    pImpl_->update();
+    return pImpl_->duplicateFilter.suppressedFrames;
 }
 
-void DisplayDevice::Clear() 
+int DisplayDevice::GetLastFrameRowsWritten()
 {
-    pImpl_->processEvents(OnDisconnect);
-    pImpl_->clear();
+    return pImpl_->lastFrameRowsWritten;
 }
 
-#endif
\ No newline at end of file
+const std::string& DisplayDevice::GetBackendName()
+{
+    return backendName_;
+}
+
+FrameBus& DisplayDevice::Frames()
+{
+    return frames_;
+}
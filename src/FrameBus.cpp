@@ -0,0 +1,287 @@
+#include "FrameBus.hpp"
+#include "MetricsService.hpp"
+#include "ThreadPolicy.hpp"
+#include "Utils.hpp"
+#include "ConfigService.hpp"
+static auto& config = ConfigService::global;
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <thread>
+#include <fmt/format.h>
+
+// Spare buffers kept around for reuse. More than this and they're freed when they come back.
+static const size_t MAX_POOLED_FRAMES = 8;
+
+// Frame buffers that nobody's holding any more
+struct FrameBusPool
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ImageRGBA>> free;
+    int width;
+    int height;
+
+    FrameBusPool(int width, int height) : width(width), height(height)
+    {
+    }
+
+    std::unique_ptr<ImageRGBA> Take()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!free.empty())
+            {
+                std::unique_ptr<ImageRGBA> image = std::move(free.back());
+                free.pop_back();
+                return image;
+            }
+        }
+        return std::make_unique<ImageRGBA>(width, height);
+    }
+
+    void Return(ImageRGBA* image)
+    {
+        std::unique_ptr<ImageRGBA> owned(image);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free.size() < MAX_POOLED_FRAMES)
+        {
+            free.push_back(std::move(owned));
+        }
+    }
+};
+
+struct FrameSubscriber
+{
+    std::string name;
+    FrameSubscriberOptions options;
+    FrameBus::Handler handler;
+    std::function<bool()> wanted;
+
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::deque<std::pair<SharedFrame, FrameTimePoint>> queue;
+    bool stopping = false;
+    std::unique_ptr<std::thread> thread;
+
+    MetricsPhase* metrics;
+    std::atomic<uint64_t>* deliveredCounter;
+    std::atomic<uint64_t>* droppedCounter;
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Publishing thread: queue a frame, making room by the drop policy if need be
+    void Enqueue(const SharedFrame& frame, FrameTimePoint time)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= (size_t)options.queueDepth)
+            {
+                dropped++;
+                (*droppedCounter)++;
+                if (options.dropPolicy == FrameDropPolicy::DropNewest)
+                    return;
+                queue.pop_front();
+            }
+            queue.emplace_back(frame, time);
+        }
+        queued.notify_one();
+    }
+
+    void Run()
+    {
+        ThreadPolicy::Apply("output");
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            queued.wait(lock, [&]() { return stopping || !queue.empty(); });
+            if (stopping)
+                break;
+
+            auto entry = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+
+            try
+            {
+                MetricsTimer timer(*metrics);
+                handler(entry.first, entry.second);
+            }
+            catch (const std::exception& e)
+            {
+                fprintf(stderr, "Frame bus subscriber %s failed: %s\n", name.c_str(), e.what());
+            }
+            delivered++;
+            (*deliveredCounter)++;
+
+            // Let the buffer go back to the pool before waiting on the next one
+            entry.first = nullptr;
+            lock.lock();
+        }
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        queued.notify_all();
+        thread->join();
+    }
+};
+
+FrameSubscription::FrameSubscription(FrameBus& bus, std::shared_ptr<FrameSubscriber> subscriber) :
+    bus_(bus),
+    subscriber_(std::move(subscriber))
+{
+}
+
+FrameSubscription::~FrameSubscription()
+{
+    bus_.unsubscribe(subscriber_);
+    subscriber_->Stop();
+}
+
+uint64_t FrameSubscription::FramesDelivered() const
+{
+    return subscriber_->delivered;
+}
+
+uint64_t FrameSubscription::FramesDropped() const
+{
+    return subscriber_->dropped;
+}
+
+FrameBus::FrameBus(int width, int height) :
+    width_(width),
+    height_(height),
+    pool_(std::make_shared<FrameBusPool>(width, height))
+{
+}
+
+FrameBus::~FrameBus()
+{
+    assert(subscribers_.empty()); // Subscriptions must go before the bus does
+}
+
+std::unique_ptr<FrameSubscription> FrameBus::Subscribe(const std::string& name, FrameSubscriberOptions options,
+                                                       Handler handler, std::function<bool()> wanted)
+{
+    // The queue is set up once, so config changes apply the next time this subscriber starts
+    std::string defaultPolicy = options.dropPolicy == FrameDropPolicy::DropNewest ? "newest" : "oldest";
+    int queueDepth = config.GetConfigValue(fmt::format("frameBus.{}.queueDepth", name), options.queueDepth);
+    std::string dropPolicy = config.GetConfigValue(fmt::format("frameBus.{}.dropPolicy", name), defaultPolicy);
+
+    auto subscriber = std::make_shared<FrameSubscriber>();
+    subscriber->name = name;
+    subscriber->options.queueDepth = std::max(queueDepth, 1);
+    subscriber->options.dropPolicy = iequals(dropPolicy, "newest") ? FrameDropPolicy::DropNewest : FrameDropPolicy::DropOldest;
+    subscriber->handler = std::move(handler);
+    subscriber->wanted = std::move(wanted);
+    subscriber->metrics = &MetricsService::Phase(fmt::format("frameBus.{}", name));
+    subscriber->deliveredCounter = &MetricsService::Counter(fmt::format("frameBus.{}.delivered", name));
+    subscriber->droppedCounter = &MetricsService::Counter(fmt::format("frameBus.{}.dropped", name));
+
+    FrameSubscriber* raw = subscriber.get();
+    subscriber->thread = std::make_unique<std::thread>([raw]() { raw->Run(); });
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        subscribers_.push_back(subscriber);
+    }
+
+    return std::unique_ptr<FrameSubscription>(new FrameSubscription(*this, subscriber));
+}
+
+void FrameBus::unsubscribe(const std::shared_ptr<FrameSubscriber>& subscriber)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribers_.erase(std::remove(subscribers_.begin(), subscribers_.end(), subscriber), subscribers_.end());
+}
+
+std::vector<std::shared_ptr<FrameSubscriber>> FrameBus::wantedSubscribers()
+{
+    std::vector<std::shared_ptr<FrameSubscriber>> targets;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& subscriber : subscribers_)
+    {
+        if (!subscriber->wanted || subscriber->wanted())
+        {
+            targets.push_back(subscriber);
+        }
+    }
+    return targets;
+}
+
+bool FrameBus::Wanted()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& subscriber : subscribers_)
+    {
+        if (!subscriber->wanted || subscriber->wanted())
+            return true;
+    }
+    return false;
+}
+
+std::shared_ptr<ImageRGBA> FrameBus::newFrame()
+{
+    // The pool is shared with the deleter, so frames can still be let go of after the bus is gone
+    std::shared_ptr<FrameBusPool> pool = pool_;
+    return std::shared_ptr<ImageRGBA>(pool->Take().release(), [pool](ImageRGBA* image) { pool->Return(image); });
+}
+
+void FrameBus::publish(const SharedFrame& frame, FrameTimePoint time, const std::vector<std::shared_ptr<FrameSubscriber>>& targets)
+{
+    for (const auto& subscriber : targets)
+    {
+        subscriber->Enqueue(frame, time);
+    }
+}
+
+void FrameBus::Publish(const ImageRGBA& frame, FrameTimePoint time)
+{
+    static MetricsPhase& publishMetrics = MetricsService::Phase("frameBus.publish");
+
+    assert(frame.width() == width_ && frame.height() == height_);
+
+    auto targets = wantedSubscribers();
+    if (targets.empty())
+        return;
+
+    MetricsTimer timer(publishMetrics);
+    std::shared_ptr<ImageRGBA> buffer = newFrame();
+    memcpy(buffer->data(), frame.data(), width_ * height_ * 4);
+    publish(buffer, time, targets);
+}
+
+void FrameBus::PublishBlank(FrameTimePoint time)
+{
+    auto targets = wantedSubscribers();
+    if (targets.empty())
+        return;
+
+    std::shared_ptr<ImageRGBA> buffer = newFrame();
+    memset(buffer->data(), 0, width_ * height_ * 4);
+    publish(buffer, time, targets);
+}
+
+void FrameBus::SetFrameRequestHandler(std::function<void()> handler)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    frameRequestHandler_ = std::move(handler);
+}
+
+void FrameBus::RequestFrame()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frameRequestHandler_)
+    {
+        frameRequestHandler_();
+    }
+}
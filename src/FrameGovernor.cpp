@@ -0,0 +1,284 @@
+#include "FrameGovernor.hpp"
+#include "MetricsService.hpp"
+#include "TimeService.hpp"
+#include "ConfigService.hpp"
+static auto& config = ConfigService::global;
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <fmt/format.h>
+
+static const bool DEFAULT_GOVERNOR_ENABLED = false;
+static const double DEFAULT_GOVERNOR_INTERVAL_SECONDS = 2.0;
+static const std::string DEFAULT_THERMAL_PATH = "/sys/class/thermal/thermal_zone0/temp";
+static const std::string DEFAULT_CPU_FREQ_PATH = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq";
+static const std::string DEFAULT_CPU_MAX_FREQ_PATH = "/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq";
+static const double DEFAULT_HOT_CELSIUS = 75.0;
+static const double DEFAULT_COOL_CELSIUS = 65.0;
+static const double DEFAULT_THROTTLED_RATIO = 0.9;
+static const int DEFAULT_STEP_DOWN_SAMPLES = 3;
+static const int DEFAULT_STEP_UP_SAMPLES = 5;
+static const double DEFAULT_HEADROOM_RATIO = 0.7;
+static const std::vector<double> DEFAULT_FPS_SCALES = { 1.0, 0.75, 0.5, 0.5 };
+static const std::vector<double> DEFAULT_QUALITY_SCALES = { 1.0, 1.0, 0.75, 0.5 };
+
+// What one look at the sensors and frame times found. NAN for anything unreadable.
+struct GovernorSample
+{
+    double celsius = NAN;
+    double cpuFreqKHz = NAN;
+    double cpuMaxFreqKHz = NAN;
+    double frameP90Us = NAN;
+    size_t frames = 0;
+};
+
+static std::mutex governorMutex;
+static bool enabled = DEFAULT_GOVERNOR_ENABLED;
+static double intervalSeconds = DEFAULT_GOVERNOR_INTERVAL_SECONDS;
+static FrameDuration interval;
+static std::string thermalPath;
+static std::string cpuFreqPath;
+static std::string cpuMaxFreqPath;
+static double hotCelsius = DEFAULT_HOT_CELSIUS;
+static double coolCelsius = DEFAULT_COOL_CELSIUS;
+static double throttledRatio = DEFAULT_THROTTLED_RATIO;
+static int stepDownSamples = DEFAULT_STEP_DOWN_SAMPLES;
+static int stepUpSamples = DEFAULT_STEP_UP_SAMPLES;
+static double headroomRatio = DEFAULT_HEADROOM_RATIO;
+static nlohmann::json fpsScalesSetting = nlohmann::json(DEFAULT_FPS_SCALES);
+static nlohmann::json qualityScalesSetting = nlohmann::json(DEFAULT_QUALITY_SCALES);
+static std::vector<double> fpsScales = { 1.0 };
+static std::vector<double> qualityScales = { 1.0 };
+
+static double frameRate = 0;
+static int level = 0;
+static int overBudgetCount = 0;
+static int recoveredCount = 0;
+static FrameTimePoint nextSample;
+static uint64_t framesSeen = 0;
+static GovernorSample lastSample;
+static std::string lastChange;
+static std::atomic<float> qualityScale(1.0f);
+
+static std::vector<double> readScales(const nlohmann::json& value)
+{
+    std::vector<double> scales;
+    if (value.is_array())
+    {
+        for (const auto& scale : value)
+        {
+            if (scale.is_number())
+            {
+                scales.push_back(std::clamp(scale.get<double>(), 0.05, 1.0));
+            }
+        }
+    }
+    return scales.empty() ? std::vector<double> { 1.0 } : scales;
+}
+
+// The first number in a sysfs style file, or NAN if there isn't one
+static double readNumber(const std::string& path)
+{
+    if (path.empty())
+        return NAN;
+
+    std::ifstream file(path);
+    double value;
+    if (!(file >> value))
+        return NAN;
+    return value;
+}
+
+// How long a frame can take at a level, in microseconds
+static double frameBudgetUs(int atLevel)
+{
+    return 1e6 / (frameRate * fpsScales[atLevel]);
+}
+
+static void applyLevel()
+{
+    TimeService::SetTargetFrameRate(frameRate * fpsScales[level]);
+    qualityScale = (float)qualityScales[level];
+}
+
+static void changeLevel(int newLevel, const std::string& reason)
+{
+    static std::atomic<uint64_t>& stepsDownCounter = MetricsService::Counter("governor.stepsDown");
+    static std::atomic<uint64_t>& stepsUpCounter = MetricsService::Counter("governor.stepsUp");
+
+    (newLevel > level ? stepsDownCounter : stepsUpCounter)++;
+    level = newLevel;
+    overBudgetCount = 0;
+    recoveredCount = 0;
+    lastChange = reason;
+    applyLevel();
+
+    fprintf(stderr, "Frame governor at level %d (%.1f fps, quality %.2f): %s\n",
+            level, frameRate * fpsScales[level], qualityScales[level], reason.c_str());
+}
+
+// The 90th percentile of the frames recorded since the last sample
+static void sampleFrameTimes(GovernorSample& sample)
+{
+    static MetricsPhase& frameMetrics = MetricsService::Phase("render.frame");
+
+    MetricsPhase::Summary summary = frameMetrics.Read();
+    uint64_t first = std::max<uint64_t>(framesSeen, summary.count - std::min<uint64_t>(summary.count, MetricsPhase::RING_SIZE));
+    std::vector<uint32_t> recent;
+    for (uint64_t i = first; i < summary.count; i++)
+    {
+        recent.push_back(summary.recentMicroseconds[i % MetricsPhase::RING_SIZE]);
+    }
+    framesSeen = summary.count;
+
+    sample.frames = recent.size();
+    if (!recent.empty())
+    {
+        size_t rank = (size_t)std::ceil(0.9 * recent.size()) - 1;
+        std::nth_element(recent.begin(), recent.begin() + rank, recent.end());
+        sample.frameP90Us = recent[rank];
+    }
+}
+
+void FrameGovernor::Init()
+{
+    // This runs once straight away, then again whenever a setting changes
+    config.Subscribe([](const ConfigUpdateEventArg& arg)
+    {
+        std::lock_guard<std::mutex> lock(governorMutex);
+
+        bool changed = arg.UpdateIfChanged("governor.enabled", enabled, DEFAULT_GOVERNOR_ENABLED);
+        changed = arg.UpdateIfChanged("governor.intervalSeconds", intervalSeconds, DEFAULT_GOVERNOR_INTERVAL_SECONDS) || changed;
+        changed = arg.UpdateIfChanged("governor.thermalPath", thermalPath, DEFAULT_THERMAL_PATH) || changed;
+        changed = arg.UpdateIfChanged("governor.cpuFreqPath", cpuFreqPath, DEFAULT_CPU_FREQ_PATH) || changed;
+        changed = arg.UpdateIfChanged("governor.cpuMaxFreqPath", cpuMaxFreqPath, DEFAULT_CPU_MAX_FREQ_PATH) || changed;
+        changed = arg.UpdateIfChanged("governor.hotCelsius", hotCelsius, DEFAULT_HOT_CELSIUS) || changed;
+        changed = arg.UpdateIfChanged("governor.coolCelsius", coolCelsius, DEFAULT_COOL_CELSIUS) || changed;
+        changed = arg.UpdateIfChanged("governor.throttledRatio", throttledRatio, DEFAULT_THROTTLED_RATIO) || changed;
+        changed = arg.UpdateIfChanged("governor.stepDownSamples", stepDownSamples, DEFAULT_STEP_DOWN_SAMPLES) || changed;
+        changed = arg.UpdateIfChanged("governor.stepUpSamples", stepUpSamples, DEFAULT_STEP_UP_SAMPLES) || changed;
+        changed = arg.UpdateIfChanged("governor.headroomRatio", headroomRatio, DEFAULT_HEADROOM_RATIO) || changed;
+        changed = arg.UpdateIfChanged("governor.fpsScales", fpsScalesSetting, nlohmann::json(DEFAULT_FPS_SCALES)) || changed;
+        changed = arg.UpdateIfChanged("governor.qualityScales", qualityScalesSetting, nlohmann::json(DEFAULT_QUALITY_SCALES)) || changed;
+        if (!changed)
+            return;
+
+        interval = std::chrono::duration_cast<FrameDuration>(fractionalSeconds(std::max(0.1, intervalSeconds)));
+        stepDownSamples = std::max(1, stepDownSamples);
+        stepUpSamples = std::max(1, stepUpSamples);
+
+        // Levels run as far as both lists go
+        fpsScales = readScales(fpsScalesSetting);
+        qualityScales = readScales(qualityScalesSetting);
+        size_t levels = std::min(fpsScales.size(), qualityScales.size());
+        fpsScales.resize(levels);
+        qualityScales.resize(levels);
+
+        if (!enabled)
+        {
+            fpsScales = { 1.0 };
+            qualityScales = { 1.0 };
+        }
+
+        // Stay at the same level if there still is one, and start counting samples afresh
+        level = std::min(level, (int)fpsScales.size() - 1);
+        overBudgetCount = 0;
+        recoveredCount = 0;
+        nextSample = FrameClock::now() + interval;
+        if (frameRate > 0)
+        {
+            applyLevel();
+        }
+    });
+}
+
+void FrameGovernor::SetFrameRate(double fps)
+{
+    std::lock_guard<std::mutex> lock(governorMutex);
+    frameRate = fps;
+    applyLevel();
+}
+
+void FrameGovernor::Poll()
+{
+    std::lock_guard<std::mutex> lock(governorMutex);
+    if (!enabled || frameRate <= 0)
+        return;
+
+    FrameTimePoint now = FrameClock::now();
+    if (now < nextSample)
+        return;
+    nextSample = now + interval;
+
+    GovernorSample sample;
+    double milliCelsius = readNumber(thermalPath);
+    sample.celsius = milliCelsius / 1000.0;
+    sample.cpuFreqKHz = readNumber(cpuFreqPath);
+    sample.cpuMaxFreqKHz = readNumber(cpuMaxFreqPath);
+    sampleFrameTimes(sample);
+    lastSample = sample;
+
+    // NAN compares false, so whatever couldn't be read doesn't count either way
+    bool hot = sample.celsius >= hotCelsius;
+    bool cool = !(sample.celsius > coolCelsius);
+    bool throttled = sample.cpuFreqKHz < sample.cpuMaxFreqKHz * throttledRatio;
+    bool overBudget = sample.frameP90Us > frameBudgetUs(level);
+    bool roomToSpare = level > 0 && !(sample.frameP90Us > frameBudgetUs(level - 1) * headroomRatio);
+
+    overBudgetCount = overBudget ? overBudgetCount + 1 : 0;
+    recoveredCount = (cool && roomToSpare) ? recoveredCount + 1 : 0;
+
+    int lowest = (int)fpsScales.size() - 1;
+    if (level < lowest && hot)
+    {
+        changeLevel(level + 1, fmt::format("{:.1f}C is too hot", sample.celsius));
+    }
+    else if (level < lowest && overBudget && throttled)
+    {
+        changeLevel(level + 1, fmt::format("frames over budget with the CPU throttled to {:.0f} MHz", sample.cpuFreqKHz / 1000.0));
+    }
+    else if (level < lowest && overBudgetCount >= stepDownSamples)
+    {
+        changeLevel(level + 1, fmt::format("90% of frames took up to {:.1f} ms", sample.frameP90Us / 1000.0));
+    }
+    else if (recoveredCount >= stepUpSamples)
+    {
+        changeLevel(level - 1, "recovered");
+    }
+}
+
+float FrameGovernor::QualityScale()
+{
+    return qualityScale;
+}
+
+nlohmann::json FrameGovernor::Report()
+{
+    std::lock_guard<std::mutex> lock(governorMutex);
+
+    // JSON has no NAN, so unreadable values are null
+    auto value = [](double v) { return std::isnan(v) ? nlohmann::json() : nlohmann::json(v); };
+
+    nlohmann::json report;
+    report["enabled"] = enabled;
+    report["level"] = level;
+    report["levels"] = fpsScales.size();
+    report["fpsLimit"] = frameRate;
+    report["fps"] = frameRate * fpsScales[level];
+    report["quality"] = qualityScales[level];
+    report["lastChange"] = lastChange;
+    report["sample"] =
+    {
+        {"celsius", value(lastSample.celsius)},
+        {"cpuFreqKHz", value(lastSample.cpuFreqKHz)},
+        {"cpuMaxFreqKHz", value(lastSample.cpuMaxFreqKHz)},
+        {"frameP90Us", value(lastSample.frameP90Us)},
+        {"frames", lastSample.frames}
+    };
+    return report;
+}
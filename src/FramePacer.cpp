@@ -0,0 +1,116 @@
+#include "FramePacer.hpp"
+
+#include <thread>
+
+static const double DEFAULT_FRAME_RATE = 60.0;
+
+FramePacer::FramePacer()
+{
+    spinThreshold_ = std::chrono::microseconds(500);
+    overrunPolicy_ = FrameOverrunPolicy::Skip;
+    maxCatchUpFrames_ = 3;
+    skippedFrames_ = 0;
+    SetTargetFrameRate(DEFAULT_FRAME_RATE);
+}
+
+void FramePacer::SetTargetFrameRate(double fps)
+{
+    if (fps <= 0.0)
+        fps = DEFAULT_FRAME_RATE;
+
+    targetDelta_ = std::chrono::duration_cast<FrameDuration>(fractionalSeconds(1.0 / fps));
+    Reset();
+}
+
+void FramePacer::SetOverrunPolicy(FrameOverrunPolicy policy)
+{
+    overrunPolicy_ = policy;
+}
+
+void FramePacer::SetSpinThreshold(FrameDuration threshold)
+{
+    spinThreshold_ = threshold < FrameDuration::zero() ? FrameDuration::zero() : threshold;
+}
+
+void FramePacer::SetMaxCatchUpFrames(int frames)
+{
+    maxCatchUpFrames_ = frames < 0 ? 0 : frames;
+}
+
+FrameDuration FramePacer::GetTargetFrameDelta() const
+{
+    return targetDelta_;
+}
+
+FrameDuration FramePacer::GetLastFrameDelta() const
+{
+    return lastDelta_;
+}
+
+uint64_t FramePacer::GetSkippedFrameCount() const
+{
+    return skippedFrames_;
+}
+
+void FramePacer::Reset()
+{
+    scheduleValid_ = false;
+    lastDelta_ = targetDelta_;
+}
+
+void FramePacer::FinishAndWaitForNextFrame()
+{
+    FrameTimePoint now = FrameClock::now();
+
+    if (!scheduleValid_)
+    {
+        // First frame of a new schedule, anchor the grid to now
+        nextDeadline_ = now + targetDelta_;
+        frameStart_ = now;
+        scheduleValid_ = true;
+    }
+    else
+    {
+        // Deadlines are always advanced by a whole period from the last deadline,
+        // never from "now", so wake-up latency does not accumulate
+        nextDeadline_ += targetDelta_;
+    }
+
+    if (now > nextDeadline_)
+    {
+        // We overran. Count how many whole slots we are behind.
+        int64_t behind = (now - nextDeadline_) / targetDelta_;
+
+        if (overrunPolicy_ == FrameOverrunPolicy::Skip || behind >= maxCatchUpFrames_)
+        {
+            // Realign to the first deadline in the future, staying on the original grid
+            nextDeadline_ += targetDelta_ * (behind + 1);
+            skippedFrames_ += behind + 1;
+        }
+        // Otherwise leave the deadline in the past and return immediately,
+        // the following frames will run back to back until we've caught up
+    }
+
+    WaitUntil(nextDeadline_);
+
+    now = FrameClock::now();
+    lastDelta_ = now - frameStart_;
+    frameStart_ = now;
+}
+
+void FramePacer::WaitUntil(FrameTimePoint deadline) const
+{
+    // Sleep for the bulk of the wait. The scheduler may overshoot this by a
+    // fair bit, which is why we stop short of the deadline.
+    FrameTimePoint sleepUntil = deadline - spinThreshold_;
+    if (FrameClock::now() < sleepUntil)
+    {
+        std::this_thread::sleep_until(sleepUntil);
+    }
+
+    // Spin out the remainder for sub-millisecond accuracy
+    while (FrameClock::now() < deadline)
+    {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,294 @@
+#include "FrameRecording.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+
+static const char RECORDING_MAGIC[4] = {'M', 'M', 'R', 'C'};
+static const uint32_t RECORDING_VERSION = 1;
+
+static const uint8_t FRAME_KEY = 0;
+static const uint8_t FRAME_DELTA = 1;
+
+static const uint8_t ROW_UNCHANGED = 0;
+static const uint8_t ROW_ENCODED = 1;
+
+// Shorter runs of zeros than this are cheaper to leave in the literal bytes
+static const size_t MIN_ZERO_RUN = 4;
+
+// Guard against corrupt size fields asking for huge allocations
+static const uint32_t MAX_PAYLOAD_FACTOR = 2;
+
+template <typename T>
+static void writeValue(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool readValue(std::istream& in, T& value)
+{
+    return (bool)in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+static void writeVarint(std::vector<uint8_t>& out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+static size_t readVarint(const uint8_t*& in, const uint8_t* end)
+{
+    size_t value = 0;
+    int shift = 0;
+    while (in < end && shift < 35)
+    {
+        uint8_t b = *in++;
+        value |= (size_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            return value;
+        shift += 7;
+    }
+    throw std::runtime_error("Corrupt frame payload (bad run length)!");
+}
+
+// XOR one row against the previous frame's and append it to the payload
+static void encodeRow(const uint8_t* row, const uint8_t* previous, size_t length, std::vector<uint8_t>& out)
+{
+    if (memcmp(row, previous, length) == 0)
+    {
+        out.push_back(ROW_UNCHANGED);
+        return;
+    }
+
+    out.push_back(ROW_ENCODED);
+    size_t i = 0;
+    while (i < length)
+    {
+        size_t zeros = 0;
+        while (i + zeros < length && row[i + zeros] == previous[i + zeros])
+            zeros++;
+        i += zeros;
+
+        // Literal bytes run until the next zero run that's worth breaking for
+        size_t literalEnd = i;
+        while (literalEnd < length)
+        {
+            size_t run = 0;
+            while (literalEnd + run < length && run < MIN_ZERO_RUN && row[literalEnd + run] == previous[literalEnd + run])
+                run++;
+            if (run == MIN_ZERO_RUN || literalEnd + run == length)
+                break;
+            literalEnd += run + 1;
+        }
+
+        writeVarint(out, zeros);
+        writeVarint(out, literalEnd - i);
+        for (; i < literalEnd; i++)
+        {
+            out.push_back(row[i] ^ previous[i]);
+        }
+    }
+}
+
+void EncodeFramePayload(const uint8_t* frame, const uint8_t* previous, int width, int height, std::vector<uint8_t>& payload)
+{
+    size_t rowBytes = width * 4;
+    for (int y=0; y < height; y++)
+    {
+        encodeRow(frame + y * rowBytes, previous + y * rowBytes, rowBytes, payload);
+    }
+}
+
+void DecodeFramePayload(const uint8_t* payload, size_t size, uint8_t* current, int width, int height)
+{
+    const uint8_t* in = payload;
+    const uint8_t* end = in + size;
+    size_t rowBytes = width * 4;
+    for (int y=0; y < height; y++)
+    {
+        if (in >= end)
+            throw std::runtime_error("Corrupt frame payload (truncated frame)!");
+
+        uint8_t* row = current + y * rowBytes;
+        if (*in++ == ROW_UNCHANGED)
+            continue;
+
+        size_t i = 0;
+        while (i < rowBytes)
+        {
+            i += readVarint(in, end);
+            size_t literal = readVarint(in, end);
+            if (i + literal > rowBytes || literal > (size_t)(end - in))
+                throw std::runtime_error("Corrupt frame payload (run overflows row)!");
+            for (size_t n=0; n < literal; n++)
+            {
+                row[i++] ^= *in++;
+            }
+        }
+    }
+}
+
+FrameRecorder::FrameRecorder(const std::string& path, int width, int height, int keyframeInterval) :
+    file_(path, std::ios::binary | std::ios::trunc),
+    width_(width),
+    height_(height),
+    keyframeInterval_(std::max(keyframeInterval, 1)),
+    previous_(width * height * 4),
+    framesWritten_(0),
+    bytesWritten_(0)
+{
+    if (!file_)
+    {
+        throw std::runtime_error(fmt::format("Couldn't create frame recording {}!", path));
+    }
+
+    file_.write(RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+    writeValue<uint32_t>(file_, RECORDING_VERSION);
+    writeValue<uint32_t>(file_, width_);
+    writeValue<uint32_t>(file_, height_);
+    writeValue<uint32_t>(file_, keyframeInterval_);
+    bytesWritten_ = file_.tellp();
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    file_.flush();
+}
+
+void FrameRecorder::Write(const ImageRGBA& frame, FrameTimePoint time)
+{
+    if (frame.width() != width_ || frame.height() != height_)
+    {
+        throw std::runtime_error("Frame size doesn't match the recording!");
+    }
+
+    if (framesWritten_ == 0)
+    {
+        firstFrameTime_ = time;
+    }
+
+    bool keyframe = framesWritten_ % keyframeInterval_ == 0;
+    if (keyframe)
+    {
+        // Keyframes are deltas from black, so they decode without anything before them
+        std::fill(previous_.begin(), previous_.end(), 0);
+    }
+
+    payload_.clear();
+    EncodeFramePayload(frame.data(), previous_.data(), width_, height_, payload_);
+    memcpy(previous_.data(), frame.data(), previous_.size());
+
+    int64_t timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time - firstFrameTime_).count();
+    writeValue<uint8_t>(file_, keyframe ? FRAME_KEY : FRAME_DELTA);
+    writeValue<int64_t>(file_, timestampNs);
+    writeValue<uint32_t>(file_, payload_.size());
+    file_.write(reinterpret_cast<const char*>(payload_.data()), payload_.size());
+
+    // Keep whatever's recorded so far usable if we don't get to exit cleanly
+    if (keyframe)
+    {
+        file_.flush();
+    }
+
+    framesWritten_++;
+    bytesWritten_ += sizeof(uint8_t) + sizeof(int64_t) + sizeof(uint32_t) + payload_.size();
+}
+
+uint64_t FrameRecorder::FramesWritten() const
+{
+    return framesWritten_;
+}
+
+uint64_t FrameRecorder::BytesWritten() const
+{
+    return bytesWritten_;
+}
+
+FrameReplayer::FrameReplayer(const std::string& path) :
+    file_(path, std::ios::binary),
+    haveKeyframe_(false)
+{
+    if (!file_)
+    {
+        throw std::runtime_error(fmt::format("Couldn't open frame recording {}!", path));
+    }
+
+    char magic[sizeof(RECORDING_MAGIC)];
+    uint32_t version, width, height, keyframeInterval;
+    file_.read(magic, sizeof(magic));
+    if (!file_ || memcmp(magic, RECORDING_MAGIC, sizeof(magic)) != 0 ||
+        !readValue(file_, version) || version != RECORDING_VERSION ||
+        !readValue(file_, width) || !readValue(file_, height) || !readValue(file_, keyframeInterval) ||
+        width == 0 || height == 0)
+    {
+        throw std::runtime_error(fmt::format("{} isn't a frame recording this version understands!", path));
+    }
+
+    width_ = width;
+    height_ = height;
+    current_.resize(width_ * height_ * 4);
+    firstFrame_ = file_.tellg();
+}
+
+int FrameReplayer::Width() const
+{
+    return width_;
+}
+
+int FrameReplayer::Height() const
+{
+    return height_;
+}
+
+bool FrameReplayer::Next(ImageRGBA& frame, int64_t& timestampNs)
+{
+    if (frame.width() != width_ || frame.height() != height_)
+    {
+        throw std::runtime_error("Frame size doesn't match the recording!");
+    }
+
+    while (true)
+    {
+        uint8_t type;
+        uint32_t payloadSize;
+        if (!readValue(file_, type) || !readValue(file_, timestampNs) || !readValue(file_, payloadSize))
+            return false;
+
+        if (type > FRAME_DELTA || payloadSize > current_.size() * MAX_PAYLOAD_FACTOR + height_)
+        {
+            throw std::runtime_error("Corrupt frame recording (bad frame header)!");
+        }
+
+        payload_.resize(payloadSize);
+        if (!file_.read(reinterpret_cast<char*>(payload_.data()), payloadSize))
+            return false;
+
+        if (type == FRAME_KEY)
+        {
+            std::fill(current_.begin(), current_.end(), 0);
+            haveKeyframe_ = true;
+        }
+        else if (!haveKeyframe_)
+        {
+            // Nothing to apply this delta to, so skip ahead to the next keyframe
+            continue;
+        }
+
+        DecodeFramePayload(payload_.data(), payload_.size(), current_.data(), width_, height_);
+        memcpy(frame.data(), current_.data(), current_.size());
+        return true;
+    }
+}
+
+void FrameReplayer::Rewind()
+{
+    file_.clear();
+    file_.seekg(firstFrame_);
+    haveKeyframe_ = false;
+}
@@ -9,6 +9,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <iostream>
+#include <algorithm>
 
 #ifdef PI_HOST
 #include <bcm_host.h>
@@ -16,9 +17,22 @@
 #endif
 
 #include "GLError.hpp"
+#include "GfxProgram.hpp"
+#include "GfxTexture.hpp"
+#include "MetricsService.hpp"
 #include "ConfigService.hpp"
 static auto& config = ConfigService::global;
 
+static const bool DEFAULT_PIXEL_BUFFER_READBACK = true;
+static const bool DEFAULT_POST_PROCESS = false;
+static const bool DEFAULT_POST_PROCESS_DITHER = true;
+static const double DEFAULT_POST_PROCESS_GAMMA = 2.2;
+static const double DEFAULT_WHITE_BALANCE = 1.0;
+static const int DEFAULT_PWM_BITS = 6;
+
+// Give up on a frame if the GPU hasn't finished it in this long
+static const GLuint64 READBACK_TIMEOUT_NS = 1000000000;
+
 #ifdef PI_HOST
 static const EGLint attribute_list[] =
 {
@@ -47,6 +61,13 @@ static const EGLint context_attributes[] =
     EGL_NONE
 };
 
+// Tried first, since GLES3 lets us read frames back without stalling
+static const EGLint context_attributes_es3[] = 
+{
+    EGL_CONTEXT_CLIENT_VERSION, 3,
+    EGL_NONE
+};
+
 #ifdef PI_HOST
 // Generic Buffer Management (GBM) device
 // Direct Rendering Manager (DRM)
@@ -55,8 +76,45 @@ static struct gbm_device* gbmDevice = nullptr;
 static struct gbm_surface* gbmSurface = nullptr;
 #endif
 
-GLRenderContext::GLRenderContext()
+GLRenderContext::GLRenderContext() :
+  frameReadSinceEndDraw(false),
+  readbackMode(ReadbackMode::Framebuffer),
+  glesVersion(2),
+  pipelineDepth(0),
+  requestedPipelineDepth(DEFAULT_PIPELINE_DEPTH),
+  drawIndex(0),
+  contextReleased(false),
+  postProcess(DEFAULT_POST_PROCESS),
+  postProcessDither(DEFAULT_POST_PROCESS_DITHER),
+  postProcessLutDirty(true),
+  postProcessGamma(DEFAULT_POST_PROCESS_GAMMA),
+  whiteBalanceRed(DEFAULT_WHITE_BALANCE),
+  whiteBalanceGreen(DEFAULT_WHITE_BALANCE),
+  whiteBalanceBlue(DEFAULT_WHITE_BALANCE),
+  pwmBits(DEFAULT_PWM_BITS),
+  SceneFramebuffer(0),
+  RemapFramebuffer(0),
+  remapLookupSource(nullptr)
 {
+  // The framebuffers and post process resources get (re)built at the start of the next frame
+  settingsConnection = config.Subscribe([&](const ConfigUpdateEventArg& arg)
+  {
+    arg.UpdateIfChanged("renderPipelineDepth", requestedPipelineDepth, DEFAULT_PIPELINE_DEPTH);
+    arg.UpdateIfChanged("postProcess.enabled", postProcess, DEFAULT_POST_PROCESS);
+    arg.UpdateIfChanged("postProcess.dither", postProcessDither, DEFAULT_POST_PROCESS_DITHER);
+    arg.UpdateIfChanged("ledPanel.pwmBits", pwmBits, DEFAULT_PWM_BITS);
+
+    bool lutChanged = false;
+    lutChanged |= arg.UpdateIfChanged("postProcess.gamma", postProcessGamma, DEFAULT_POST_PROCESS_GAMMA);
+    lutChanged |= arg.UpdateIfChanged("postProcess.whiteBalance.red", whiteBalanceRed, DEFAULT_WHITE_BALANCE);
+    lutChanged |= arg.UpdateIfChanged("postProcess.whiteBalance.green", whiteBalanceGreen, DEFAULT_WHITE_BALANCE);
+    lutChanged |= arg.UpdateIfChanged("postProcess.whiteBalance.blue", whiteBalanceBlue, DEFAULT_WHITE_BALANCE);
+    if (lutChanged)
+    {
+      postProcessLutDirty = true;
+    }
+  });
+
   // Init the OpenGL context for this drawing
   initGL();
   
@@ -65,10 +123,12 @@ GLRenderContext::GLRenderContext()
 
 GLRenderContext::~GLRenderContext()
 {
+  #ifdef PI_HOST
     if (gbmFile != -1)
     {
         close(gbmFile);
     }
+  #endif
 }
 
 void GLRenderContext::initGL()
@@ -111,11 +171,22 @@ void GLRenderContext::initGL()
   assert(EGL_FALSE != result);
   print_if_glerror("Bind OpenGL ES API");
   
-  // Create an OpenGL rendering context
-  GContext = eglCreateContext(GDisplay, glConfig, EGL_NO_CONTEXT, context_attributes);
+  // Create an OpenGL rendering context, GLES3 if we can get it
+  glesVersion = 3;
+  GContext = eglCreateContext(GDisplay, glConfig, EGL_NO_CONTEXT, context_attributes_es3);
+  if (GContext == EGL_NO_CONTEXT)
+  {
+    glesVersion = 2;
+    GContext = eglCreateContext(GDisplay, glConfig, EGL_NO_CONTEXT, context_attributes);
+  }
   assert(GContext!=EGL_NO_CONTEXT);
   print_if_glerror("Create render context");
 
+  bool pixelBufferReadback = config.GetConfigValue("pixelBufferReadback", DEFAULT_PIXEL_BUFFER_READBACK);
+  readbackMode = (glesVersion >= 3 && pixelBufferReadback) ? ReadbackMode::PixelBuffer : ReadbackMode::Framebuffer;
+  fprintf(stderr, "Render context is OpenGL ES %d, reading frames back %s.\n", glesVersion,
+          readbackMode == ReadbackMode::PixelBuffer ? "through pixel buffers with fences when pipelined" : "directly from the framebuffers");
+
 #if PI_HOST
 // create the GBM and EGL surface
 	gbmSurface = gbm_surface_create(gbmDevice, config.width(), config.height(), GBM_BO_FORMAT_XRGB8888, GBM_BO_USE_SCANOUT|GBM_BO_USE_RENDERING);
@@ -134,37 +205,562 @@ void GLRenderContext::initGL()
 	// std::cout << "Shading Language Version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 	// std::cout << "Supported Extensions: " << glGetString(GL_EXTENSIONS) << std::endl << std::flush;
 
-	// Construct our render buffer
-  FramebufferName = 0;
-  glGenFramebuffers(1, &FramebufferName);
-  glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
-  print_if_glerror("Generate framebuffer");
+	// Construct our render buffers
+  createFramebuffers(ClampPipelineDepth(requestedPipelineDepth));
+}
 
-  // Create the render texture
-  glGenTextures(1, &RenderedTexture);
+void GLRenderContext::createFramebuffers(int count)
+{
+  Framebuffers.resize(count);
+  RenderedTextures.resize(count);
+  glGenFramebuffers(count, Framebuffers.data());
+  glGenTextures(count, RenderedTextures.data());
+  print_if_glerror("Generate framebuffers");
 
-  // "Bind" the newly created texture : all future texture functions will modify this texture
-  glBindTexture(GL_TEXTURE_2D, RenderedTexture);
+  for (int i=0; i < count; i++)
+  {
+    // "Bind" the newly created texture : all future texture functions will modify this texture
+    glBindTexture(GL_TEXTURE_2D, RenderedTextures[i]);
 
-  // Give an empty image to OpenGL ( the last "0" )
-  glTexImage2D(GL_TEXTURE_2D, 0 ,GL_RGBA, config.width(), config.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    // Give an empty image to OpenGL ( the last "0" )
+    glTexImage2D(GL_TEXTURE_2D, 0 ,GL_RGBA, config.width(), config.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 
-  // Poor filtering. Needed !
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    // Poor filtering. Needed !
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    // Set the texture as color attachement #0
+    glBindFramebuffer(GL_FRAMEBUFFER, Framebuffers[i]);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, RenderedTextures[i], 0);
+
+    // Frames still in the pipeline when we start should read back as black, not garbage
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
   print_if_glerror("Setup fb texture params");
+
+  // Each frame is fenced as it ends so we can wait for just that frame.
+  // GLES2 has no fences, so there we wait for everything instead.
+  if (glesVersion >= 3)
+  {
+    Fences.assign(count, nullptr);
+  }
+
+  // With a depth of 1 the frame read back is the one just drawn, so a pixel buffer would
+  // only add a copy and the same wait for the GPU. Reading the framebuffer directly is quicker.
+  if (readbackMode == ReadbackMode::PixelBuffer && count > 1)
+  {
+    // One pixel buffer per framebuffer. Each frame is copied into its buffer as it ends,
+    // and the copy runs on the GPU while the CPU carries on.
+    PixelBuffers.resize(count);
+    glGenBuffers(count, PixelBuffers.data());
+    for (int i=0; i < count; i++)
+    {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, PixelBuffers[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, config.width() * config.height() * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    PixelBufferCopied.assign(count, false);
+    print_if_glerror("Setup readback pixel buffers");
+  }
+
+  pipelineDepth = count;
+  drawIndex = 0;
+}
+
+void GLRenderContext::destroyFramebuffers()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glDeleteFramebuffers(Framebuffers.size(), Framebuffers.data());
+  glDeleteTextures(RenderedTextures.size(), RenderedTextures.data());
+  Framebuffers.clear();
+  RenderedTextures.clear();
+
+  for (GLsync fence : Fences)
+  {
+    if (fence != nullptr)
+      glDeleteSync(fence);
+  }
+  glDeleteBuffers(PixelBuffers.size(), PixelBuffers.data());
+  Fences.clear();
+  PixelBuffers.clear();
+  PixelBufferCopied.clear();
+  pipelineDepth = 0;
+}
+
+int GLRenderContext::GetPipelineDepth()
+{
+  return pipelineDepth;
+}
+
+int GLRenderContext::ClampPipelineDepth(int requested)
+{
+  return std::min(std::max(requested, 1), MAX_PIPELINE_DEPTH);
+}
+
+ReadbackMode GLRenderContext::GetReadbackMode()
+{
+  return PixelBuffers.empty() ? ReadbackMode::Framebuffer : ReadbackMode::PixelBuffer;
+}
+
+bool GLRenderContext::ReadFrame(ImageRGBA& frame)
+{
+  assert(frame.width() == config.width() && frame.height() == config.height());
+
+  if (pipelineDepth == 0)
+    return false;
+
+  // Frames that ended while nobody was reading back weren't copied into their pixel
+  // buffer (see EndDraw), so the first few reads after a gap go straight to the framebuffer
+  frameReadSinceEndDraw = true;
+  if (PixelBuffers.empty() || !PixelBufferCopied[drawIndex])
+  {
+    // EndDraw left the oldest framebuffer bound. This waits for the GPU to finish it.
+    glReadPixels(0,0, config.width(), config.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+    return true;
+  }
+
+  // The oldest pixel buffer was filled pipelineDepth-1 frames ago, so its copy is usually done by now.
+  // The fence stays until EndDraw replaces it, since GetFrameTexture may wait on it too.
+  GLsync fence = Fences[drawIndex];
+  if (fence == nullptr)
+    return false;
+
+  GLenum waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_TIMEOUT_NS);
+  if (waitResult == GL_TIMEOUT_EXPIRED || waitResult == GL_WAIT_FAILED)
+    return false;
+
+  size_t size = config.width() * config.height() * 4;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, PixelBuffers[drawIndex]);
+  const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if (pixels != nullptr)
+  {
+    memcpy(frame.data(), pixels, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  print_if_glerror("Read frame from pixel buffer");
+
+  return pixels != nullptr;
+}
+
+bool GLRenderContext::ReadFrameBands(ImageRGBA& frame, int bandRows, const std::function<void(int firstRow, int rows)>& onBand)
+{
+  assert(frame.width() == config.width() && frame.height() == config.height());
+
+  if (pipelineDepth == 0)
+    return false;
+
+  int height = config.height();
+  size_t rowBytes = config.width() * 4;
+  bandRows = bandRows > 0 ? std::min(bandRows, height) : height;
+
+  frameReadSinceEndDraw = true;
+  if (PixelBuffers.empty() || !PixelBufferCopied[drawIndex])
+  {
+    // The first band waits for the GPU to finish the frame, the rest are just copies
+    for (int y=0; y < height; y += bandRows)
+    {
+      int rows = std::min(bandRows, height - y);
+      glReadPixels(0, y, config.width(), rows, GL_RGBA, GL_UNSIGNED_BYTE, frame.data() + y * rowBytes);
+      onBand(y, rows);
+    }
+    return true;
+  }
+
+  GLsync fence = Fences[drawIndex];
+  if (fence == nullptr)
+    return false;
+
+  GLenum waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_TIMEOUT_NS);
+  if (waitResult == GL_TIMEOUT_EXPIRED || waitResult == GL_WAIT_FAILED)
+    return false;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, PixelBuffers[drawIndex]);
+  const uint8_t* pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, rowBytes * height, GL_MAP_READ_BIT);
+  if (pixels != nullptr)
+  {
+    for (int y=0; y < height; y += bandRows)
+    {
+      int rows = std::min(bandRows, height - y);
+      memcpy(frame.data() + y * rowBytes, pixels + y * rowBytes, rows * rowBytes);
+      onBand(y, rows);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  print_if_glerror("Read frame bands from pixel buffer");
+
+  return pixels != nullptr;
+}
+
+void GLRenderContext::createRemap(int width, int height)
+{
+  RemapProgram = std::make_unique<GfxProgram>(
+    config.GetSharedResourcePath("remapvertshader.glsl"),
+    config.GetSharedResourcePath("remapfragshader.glsl"),
+    std::vector<std::string>());
+
+  RemapTexture = std::make_unique<GfxTexture>(width, height);
+  glGenFramebuffers(1, &RemapFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, RemapFramebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, RemapTexture->GetId(), 0);
+
+  RemapLookup = std::make_unique<GfxTexture>(width, height);
+  remapLookupSource = nullptr;
+  print_if_glerror("Create remap resources");
+}
+
+void GLRenderContext::destroyRemap()
+{
+  if (RemapFramebuffer != 0)
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &RemapFramebuffer);
+    RemapFramebuffer = 0;
+  }
+  RemapTexture = nullptr;
+  RemapLookup = nullptr;
+  RemapProgram = nullptr;
+  remapLookupSource = nullptr;
+}
+
+bool GLRenderContext::ReadFrameRemapped(const ImageRGBA& lookup, ImageRGBA& frame)
+{
+  assert(frame.width() == lookup.width() && frame.height() == lookup.height());
+
+  GLuint source = GetFrameTexture();
+  if (source == 0)
+    return false;
+
+  if (RemapFramebuffer == 0 || RemapTexture->GetWidth() != lookup.width() || RemapTexture->GetHeight() != lookup.height())
+  {
+    destroyRemap();
+    createRemap(lookup.width(), lookup.height());
+  }
+  if (remapLookupSource != &lookup)
+  {
+    RemapLookup->LoadImageToTexture(lookup);
+    remapLookupSource = &lookup;
+  }
+
+  //                 X      Y     Z     U     V
+  float mesh[] = { -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+                    1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+                   -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+                    1.0f,  1.0f, 0.0f, 1.0f, 1.0f };
+
+  glBindFramebuffer(GL_FRAMEBUFFER, RemapFramebuffer);
+  glViewport(0, 0, lookup.width(), lookup.height());
+
+  RemapProgram->Use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, source);
+  RemapProgram->SetUniform("uTexture", 0);
+  RemapProgram->SetTexture1(*RemapLookup);
+  RemapProgram->SetUniform("uFrameSize", (float)config.width(), (float)config.height());
+
+  GLint vertexAttrib = RemapProgram->Attrib("aVertex");
+  GLint coordinateAttrib = RemapProgram->Attrib("aTexCoord");
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glVertexAttribPointer(vertexAttrib, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), mesh);
+  glEnableVertexAttribArray(vertexAttrib);
+  glVertexAttribPointer(coordinateAttrib, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), mesh+3);
+  glEnableVertexAttribArray(coordinateAttrib);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  glDisableVertexAttribArray(vertexAttrib);
+  glDisableVertexAttribArray(coordinateAttrib);
+  glActiveTexture(GL_TEXTURE0);
+
+  // The frame it came from is already done, so this only waits for the remap itself
+  glReadPixels(0,0, lookup.width(), lookup.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+  print_if_glerror("Read remapped frame");
+
+  // Leave the oldest framebuffer bound, like EndDraw does, for ReadFrame
+  glBindFramebuffer(GL_FRAMEBUFFER, Framebuffers[drawIndex]);
+  glViewport(0,0,config.width(), config.height());
+  return true;
+}
+
+GLuint GLRenderContext::GetFrameTexture()
+{
+  if (pipelineDepth == 0)
+    return 0;
+
+  if (Fences.empty())
+  {
+    glFinish();
+  }
+  else
+  {
+    GLsync fence = Fences[drawIndex];
+    if (fence == nullptr)
+      return 0;
+
+    GLenum waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, READBACK_TIMEOUT_NS);
+    if (waitResult == GL_TIMEOUT_EXPIRED || waitResult == GL_WAIT_FAILED)
+      return 0;
+  }
+
+  return RenderedTextures[drawIndex];
+}
+
+EGLDisplay GLRenderContext::GetEGLDisplay()
+{
+  return GDisplay;
+}
+
+EGLContext GLRenderContext::GetEGLContext()
+{
+  return GContext;
+}
+
+int GLRenderContext::GetGLESVersion()
+{
+  return glesVersion;
+}
+
+void GLRenderContext::createPostProcess()
+{
+  try
+  {
+    // Same pixel space vertex shader as the simulator window uses
+    PostProcessProgram = std::make_unique<GfxProgram>(
+      config.GetSharedResourcePath("ledmatrixvertshader.glsl"),
+      config.GetSharedResourcePath("postprocessfragshader.glsl"),
+      std::vector<std::string>());
+  }
+  catch (const std::exception& e)
+  {
+    fprintf(stderr, "Couldn't load the post process shader, turning post processing off: %s\n", e.what());
+    postProcess = false;
+    return;
+  }
+
+  SceneTexture = std::make_unique<GfxTexture>(config.width(), config.height());
+  glGenFramebuffers(1, &SceneFramebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, SceneFramebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, SceneTexture->GetId(), 0);
+
+  PostProcessLut = std::make_unique<GfxTexture>(256, 3);
+  postProcessLutDirty = true;
+
+  // Maps each output pixel to the same pixel of the scene texture
+  //                    X                       Y                        Z     U     V
+  PostProcessMesh = { 0.0f,                   0.0f,                    0.0f, 0.0f, 0.0f,
+                      (float)config.width(),  0.0f,                    0.0f, 1.0f, 0.0f,
+                      0.0f,                   (float)config.height(),  0.0f, 0.0f, 1.0f,
+                      (float)config.width(),  (float)config.height(),  0.0f, 1.0f, 1.0f };
+
+  print_if_glerror("Create post process resources");
+}
+
+void GLRenderContext::destroyPostProcess()
+{
+  if (SceneFramebuffer != 0)
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &SceneFramebuffer);
+    SceneFramebuffer = 0;
+  }
+  SceneTexture = nullptr;
+  PostProcessLut = nullptr;
+  PostProcessProgram = nullptr;
+}
+
+void GLRenderContext::updatePostProcessLut()
+{
+  // 16 bit entries so darks survive the gamma curve well enough to dither,
+  // split over two 8 bit channels since GLES2 has nothing wider
+  ImageRGBA lut(256, 3);
+  double balance[3] = { whiteBalanceRed, whiteBalanceGreen, whiteBalanceBlue };
+  uint8_t* entry = lut.data();
+  for (int channel=0; channel < 3; channel++)
+  {
+    for (int i=0; i < 256; i++)
+    {
+      double value = std::min(std::max(pow(i / 255.0, postProcessGamma) * balance[channel], 0.0), 1.0);
+      uint16_t level = (uint16_t)lround(value * 65535.0);
+      entry[0] = level >> 8;
+      entry[1] = level & 0xFF;
+      entry[2] = 0;
+      entry[3] = 255;
+      entry += 4;
+    }
+  }
+
+  PostProcessLut->LoadImageToTexture(lut);
+  postProcessLutDirty = false;
+}
+
+void GLRenderContext::postProcessFrame()
+{
+  static MetricsPhase& metrics = MetricsService::Phase("render.postProcess");
+  MetricsTimer timer(metrics);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, Framebuffers[drawIndex]);
+  glViewport(0,0,config.width(), config.height());
+
+  // The panel library maps 8 bit values to its PWM bits by keeping the top bits,
+  // so each level is a whole step of 2^(8 - bits)
+  int bits = std::min(std::max(pwmBits, 1), 8);
+  PostProcessProgram->Use();
+  PostProcessProgram->SetTexture0(*SceneTexture);
+  PostProcessProgram->SetTexture1(*PostProcessLut);
+  PostProcessProgram->SetUniform("uLocation", 0.0f, 0.0f);
+  PostProcessProgram->SetUniform("uLevels", (float)((1 << bits) - 1));
+  PostProcessProgram->SetUniform("uLevelStep", (float)(1 << (8 - bits)));
+  PostProcessProgram->SetUniform("uDither", postProcessDither ? 1.0f : 0.0f);
+
+  GLint vertexAttrib = PostProcessProgram->Attrib("aVertex");
+  GLint coordinateAttrib = PostProcessProgram->Attrib("aTexCoord");
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glVertexAttribPointer(vertexAttrib, 3, GL_FLOAT, GL_FALSE, 5*sizeof(float), PostProcessMesh.data());
+  glEnableVertexAttribArray(vertexAttrib);
+  glVertexAttribPointer(coordinateAttrib, 2, GL_FLOAT, GL_FALSE, 5*sizeof(float), PostProcessMesh.data()+3);
+  glEnableVertexAttribArray(coordinateAttrib);
+
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  glDisableVertexAttribArray(vertexAttrib);
+  glDisableVertexAttribArray(coordinateAttrib);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void GLRenderContext::MakeCurrent()
+{
+  eglMakeCurrent(GDisplay, GSurface, GSurface, GContext);
+}
+
+void GLRenderContext::Suspend(bool releaseContext)
+{
+  if (contextReleased)
+    return;
+
+  MakeCurrent();
+  destroyPostProcess();
+  destroyRemap();
+  destroyFramebuffers();
+  print_if_glerror("Release framebuffers");
+
+  if (releaseContext)
+  {
+    eglMakeCurrent(GDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroySurface(GDisplay, GSurface);
+    eglDestroyContext(GDisplay, GContext);
+
+  #ifdef PI_HOST
+    // We own this display, so let the driver free everything behind it too.
+    // Elsewhere the default display may be shared with the simulator window.
+    eglTerminate(GDisplay);
+    gbm_surface_destroy(gbmSurface);
+    gbm_device_destroy(gbmDevice);
+    close(gbmFile);
+    gbmSurface = nullptr;
+    gbmDevice = nullptr;
+    gbmFile = -1;
+  #endif
+
+    contextReleased = true;
+  }
+}
+
+void GLRenderContext::Resume()
+{
+  if (contextReleased)
+  {
+    // This builds the framebuffers too
+    contextReleased = false;
+    initGL();
+    print_if_glerror("RenderContext initGL");
+  }
+  else if (pipelineDepth == 0)
+  {
+    // The main loop sizes its work by GetPipelineDepth, so the framebuffers have to be back
+    // before the next frame rather than waiting for BeginDraw. Post processing and the
+    // remap pass are rebuilt by the first frame that needs them.
+    MakeCurrent();
+    createFramebuffers(ClampPipelineDepth(requestedPipelineDepth));
+    print_if_glerror("Recreate framebuffers");
+  }
 }
 
 void GLRenderContext::BeginDraw()
 {
+  static MetricsPhase& metrics = MetricsService::Phase("render.beginDraw");
+  MetricsTimer timer(metrics);
+
   // Sometimes we have multiple contexts for other stuff
   // Make the framebuffer render contenxt current here just in case
-  eglMakeCurrent(GDisplay, GSurface, GSurface, GContext);
+  MakeCurrent();
 
-  // Set "RenderedTexture" as color attachement #0
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, RenderedTexture, 0);
+  // Pick up pipeline depth changes between frames
+  int depth = ClampPipelineDepth(requestedPipelineDepth);
+  if (depth != pipelineDepth)
+  {
+    destroyFramebuffers();
+    createFramebuffers(depth);
+  }
 
-  // Bind to the frame buffer
-  glBindFramebuffer(GL_FRAMEBUFFER, FramebufferName);
+  // Pick up post processing being turned on or off, or its settings changing
+  if (postProcess && SceneFramebuffer == 0)
+  {
+    createPostProcess();
+  }
+  else if (!postProcess && SceneFramebuffer != 0)
+  {
+    destroyPostProcess();
+  }
+  if (SceneFramebuffer != 0 && postProcessLutDirty)
+  {
+    updatePostProcessLut();
+  }
+
+  // Bind to the frame buffer, or the scene's when the post process pass will copy it over
+  glBindFramebuffer(GL_FRAMEBUFFER, SceneFramebuffer != 0 ? SceneFramebuffer : Framebuffers[drawIndex]);
   glViewport(0,0,config.width(), config.height()); // Render on the whole framebuffer, complete from the lower left corner to the upper right
 }
+
+void GLRenderContext::EndDraw()
+{
+  static MetricsPhase& metrics = MetricsService::Phase("render.endDraw");
+  MetricsTimer timer(metrics);
+
+  if (SceneFramebuffer != 0)
+  {
+    postProcessFrame();
+  }
+
+  // Queue the copy into this frame's pixel buffer behind the draw calls, as long as
+  // frames are being read back. Displays that remap frames or draw the frame texture
+  // don't call ReadFrame at all, so there's no point copying for them.
+  if (!PixelBuffers.empty())
+  {
+    PixelBufferCopied[drawIndex] = frameReadSinceEndDraw;
+    if (frameReadSinceEndDraw)
+    {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, PixelBuffers[drawIndex]);
+      glReadPixels(0,0, config.width(), config.height(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+  }
+  frameReadSinceEndDraw = false;
+
+  // Fence the frame (and its copy) so readers know when it's done without waiting on anything newer
+  if (!Fences.empty())
+  {
+    if (Fences[drawIndex] != nullptr)
+      glDeleteSync(Fences[drawIndex]);
+    Fences[drawIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  // Kick off rendering now rather than when someone reads the result
+  glFlush();
+
+  // The next framebuffer in the ring holds the oldest frame, which is both
+  // the one to read back now and the one we'll draw over next
+  drawIndex = (drawIndex + 1) % pipelineDepth;
+  glBindFramebuffer(GL_FRAMEBUFFER, Framebuffers[drawIndex]);
+}
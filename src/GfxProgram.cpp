@@ -108,10 +108,13 @@ void GfxProgram::setCameraFromPixelTransform()
   // Y: [0,config.height] ==> [-1,1]
   // Z: [-1000, 1000] => [-1, 1]
 
+  // Pixel row 0 goes to the bottom of clip space, which is the first row glReadPixels
+  // returns. That renders the framebuffer upside down by GL's conventions, but frames
+  // read back in top to bottom order, which is the order the LED panel wants them in.
   auto xform = Transform3D::FromTranslationAndScale(    
-    -1, 1, 0, 
+    -1, -1, 0, 
     2.0f / (float)config.width(), 
-    -2.0f / (float)config.height(), 
+    2.0f / (float)config.height(), 
     1.0f / 1000.0f );
 
   GLint loc = glGetUniformLocation(Id, "uCameraFromPixelTransform");
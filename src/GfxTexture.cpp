@@ -60,9 +60,17 @@ void GfxTexture::LoadImageToTexture(const ImageRGBA& image)
     #ifndef NPOT_TEXTURE_SUPPORT
     throw std::runtime_error("Non-power-of-two textures are unsupported. Fix the NPOT code!");
     #endif
+    glBindTexture(GL_TEXTURE_2D, textureID);
+
+    // Same size as before, so refill the existing storage instead of reallocating it
+    if (image.width() == width && image.height() == height)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+        return;
+    }
+
     width = image.width();
     height = image.height();
-    glBindTexture(GL_TEXTURE_2D, textureID);
     glTexImage2D(GL_TEXTURE_2D, 0 , GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
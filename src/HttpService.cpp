@@ -1,6 +1,8 @@
 #include "HttpService.hpp"
 #include "ConfigService.hpp"
 static auto& config = ConfigService::global;
+#include "MetricsService.hpp"
+#include "ThreadPolicy.hpp"
 
 #include <sys/types.h>
 #include <ifaddrs.h>
@@ -9,6 +11,37 @@ static auto& config = ConfigService::global;
 
 using json = nlohmann::json;
 
+// Runs requests on httplib's own thread pool, with the http thread policy applied to
+// each worker when it picks up its first request. ThreadPool is final, so it's wrapped.
+class PolicyTaskQueue : public httplib::TaskQueue
+{
+public:
+    explicit PolicyTaskQueue(size_t threads) : pool_(threads)
+    {
+    }
+
+    // enqueue returns void or bool depending on the httplib version
+    auto enqueue(std::function<void()> fn) -> decltype(std::declval<httplib::TaskQueue&>().enqueue(fn)) override
+    {
+        return pool_.enqueue([fn]()
+        {
+            ThreadPolicy::ApplyOnce("http");
+            fn();
+        });
+    }
+
+    void shutdown() override
+    {
+        pool_.shutdown();
+    }
+
+private:
+    httplib::ThreadPool pool_;
+};
+
+// How long a handler waits for the main loop to pick up its command
+static const auto MAIN_THREAD_COMMAND_TIMEOUT = std::chrono::seconds(5);
+
 static std::string getFirstExternalHostAddr()
 {
     std::string hostAddr = "0.0.0.0";
@@ -69,6 +102,7 @@ HttpService::HttpService()
     }
         
     srv = std::make_unique<httplib::Server>();
+    srv->new_task_queue = []() { return new PolicyTaskQueue(CPPHTTPLIB_THREAD_POOL_COUNT); };
 
     // Setup the HTTP API
     setupCallbacks();
@@ -84,6 +118,7 @@ HttpService::HttpService()
 
       serverThread = std::make_unique<std::thread>([=]() 
       {
+        ThreadPolicy::Apply("http");
         srv->listen_after_bind();
       });
       
@@ -92,6 +127,7 @@ HttpService::HttpService()
     {
       serverThread = std::make_unique<std::thread>([=]() 
       {
+        ThreadPolicy::Apply("http");
         srv->listen(addr.c_str(), port);
       });
     }
@@ -150,6 +186,19 @@ void HttpService::setupCallbacks()
     {
         res.set_content(web["index.html"], "text/html");
     });
+
+    // Frame phase timings. Recording is lock free, so these never need the main loop.
+    srv->Get("/system/metrics", [=](const httplib::Request& req, httplib::Response& res) 
+    {
+        std::stringstream ss;
+        ss << std::setw(4) << MetricsService::ToJson();
+        res.set_content(ss.str(), "application/json");
+    });
+
+    srv->Get("/system/metrics/prometheus", [=](const httplib::Request& req, httplib::Response& res) 
+    {
+        res.set_content(MetricsService::ToPrometheus(), "text/plain; version=0.0.4");
+    });
 }
 
 std::string HttpService::ListeningInterface()
@@ -166,3 +215,35 @@ httplib::Server& HttpService::Server()
 {
     return *srv;
 }
+
+
+CommandQueue& HttpService::Commands()
+{
+    return commands;
+}
+
+void HttpService::RunOnMainThread(std::function<HttpResult()> command, httplib::Response& res)
+{
+    auto result = commands.Invoke(std::move(command));
+    if (result.wait_for(MAIN_THREAD_COMMAND_TIMEOUT) != std::future_status::ready)
+    {
+        res.status = 503;
+        res.body = "Timed out waiting for the main loop.";
+        return;
+    }
+
+    try
+    {
+        HttpResult r = result.get();
+        res.status = r.status;
+        if (!r.body.empty())
+        {
+            res.body = r.body;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        res.status = 500;
+        res.body = e.what();
+    }
+}
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include <math.h>
+#include <stdexcept>
 
 #include <png.h>
 #include <qrcodegen.hpp>
@@ -110,6 +111,54 @@ std::shared_ptr<ImageRGBA> ImageRGBA::FromQrPayload(const std::string& qrPayload
     return image;
 }
 
+static void pngWriteToVector(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+    auto out = static_cast<std::vector<uint8_t>*>(png_get_io_ptr(png_ptr));
+    out->insert(out->end(), data, data + length);
+}
+
+std::vector<uint8_t> ImageRGBA::ToPng(int compressionLevel) const
+{
+    std::vector<uint8_t> out;
+
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png_ptr)
+        throw std::runtime_error("png_create_write_struct failed!");
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if (!info_ptr)
+    {
+        png_destroy_write_struct(&png_ptr, NULL);
+        throw std::runtime_error("png_create_info_struct failed!");
+    }
+
+    std::vector<png_bytep> row_pointers(height_);
+    for (int y = 0; y < height_; y++)
+    {
+        row_pointers[y] = const_cast<png_bytep>(data_.data()) + width_ * 4 * y;
+    }
+
+    if (setjmp(png_jmpbuf(png_ptr)))
+    {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        throw std::runtime_error("Error encoding PNG!");
+    }
+
+    png_set_write_fn(png_ptr, &out, pngWriteToVector, NULL);
+    png_set_compression_level(png_ptr, compressionLevel);
+    png_set_IHDR(png_ptr, info_ptr, width_, height_, 8, PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    // Our rows are RGBA, so have libpng skip the alpha byte of each pixel
+    png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
+    png_write_image(png_ptr, row_pointers.data());
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    return out;
+}
+
 void ImageRGBA::read_png_file(const char* file_name)
 {
     png_byte color_type;
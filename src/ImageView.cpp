@@ -30,6 +30,15 @@ ImageView::~ImageView()
 
 }
 
+void ImageView::ReleaseGL()
+{
+  _program.reset();
+  texture.reset();
+
+  // Recreate the texture from the image next time we draw
+  dirty = image != nullptr;
+}
+
 void ImageView::SetImage(std::shared_ptr<ImageRGBA> image)
 {
   this->image = std::move(image);
@@ -2,6 +2,8 @@
 
 #ifdef LINUX_HID_CONTROLLER_SUPPORT
 
+#include "ThreadPolicy.hpp"
+
 #include <fcntl.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -125,6 +127,7 @@ UsbButton::UsbButton()
 
         pImpl_->thread = std::make_unique<std::thread>([&]()
         {
+            ThreadPolicy::Apply("button");
             while (!pImpl_->stopThread && pImpl_->buttonFd != -1)
             {
                 if (read_event(pImpl_->buttonFd, &pImpl_->event) == 0)
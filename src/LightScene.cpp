@@ -10,6 +10,15 @@ static auto& config = ConfigService::global;
 #include <chrono>
 #include <ctime>
 
+// How fast the terminator and light spread animate towards their targets
+static const double SUN_MOVE_DEG_PER_SEC = 30.0;
+static const float SUN_PROPIGATION_DEG_PER_SEC = 30.0f;
+
+// Update rates while animating and once everything has reached its target.
+// Settled, the sun only moves a fraction of a degree per minute.
+static const double ANIMATING_REFRESH_HZ = 60.0;
+static const double SETTLED_REFRESH_HZ = 1.0;
+
 LightScene::LightScene(AstronomyService& astro) : 
   Scene(SceneType::Base, SceneLifetime::Manual),
   astro(astro)
@@ -77,6 +86,14 @@ void LightScene::initGLOverride()
             (float)mapLayer1Texture->GetWidth(), (float)mapLayer1Texture->GetHeight(),  0.0f,   1.0f,   1.0f  };
 }
 
+void LightScene::releaseGLOverride()
+{
+    program.reset();
+    mapLayer1Texture.reset();
+    mapLayer2Texture.reset();
+    LonLatLookupTexture.reset();
+}
+
 void LightScene::resetOverride(bool animate)
 {
   overrideSunLocation = false;
@@ -88,6 +105,7 @@ void LightScene::resetOverride(bool animate)
     sunCurrentLat = sunTargetLat;
     sunCurrentLon = sunTargetLon;
     sunPropAngleCurrent = sunPropigationDeg;
+    publishRenderState(false);
   }
 }
 
@@ -99,13 +117,59 @@ void LightScene::updateOverride()
     astro.GetSolarPoint(TimeService::GetSceneTimeAsJulianDate(), sunTargetLat, sunTargetLon);
   }
   
-  moveTowardsAngleDeg2D(sunCurrentLat, sunCurrentLon, sunTargetLat, sunTargetLon, 0.5 * TimeService::GetSceneTimeMultiplier());
+  // Scale animation steps by the measured update time so speed doesn't depend on tick rate
+  double delta = updateDelta();
+  moveTowardsAngleDeg2D(sunCurrentLat, sunCurrentLon, sunTargetLat, sunTargetLon, 
+                        SUN_MOVE_DEG_PER_SEC * delta * TimeService::GetSceneTimeMultiplier());
   
-  moveTowards(sunPropAngleCurrent, sunPropigationDeg, 0.5f);
+  moveTowards(sunPropAngleCurrent, sunPropigationDeg, SUN_PROPIGATION_DEG_PER_SEC * (float)delta);
+
+  bool settled = sunCurrentLat == sunTargetLat && 
+                 sunCurrentLon == sunTargetLon && 
+                 sunPropAngleCurrent == sunPropigationDeg &&
+                 TimeService::GetSceneTimeMultiplier() <= 1.0;
+  setRefreshRate(settled ? SETTLED_REFRESH_HZ : ANIMATING_REFRESH_HZ);
+
+  publishRenderState(!settled);
+}
+
+void LightScene::publishRenderState(bool blend)
+{
+  RenderState state;
+  state.sunLat = sunCurrentLat;
+  state.sunLon = sunCurrentLon;
+  state.sunPropAngle = sunPropAngleCurrent;
+
+  // Do all the NOVAS work here on the update thread rather than while drawing
+  {
+    double lat, lon;
+    astro.GetSolarPoint(TimeService::GetSceneTimeAsJulianDate(), lat, lon);
+    state.lightBoost = lightAdjustEnabled ? astro.GetLightBoost(lat, lon) : 0.0f;
+  }
+  astro.GetLunarPoint(TimeService::GetSceneTimeAsJulianDate(), state.moonLat, state.moonLon);
+
+  renderState.Publish(state, blend);
 }
 
 void LightScene::drawOverride()
 {
+    auto snapshot = renderState.Latest();
+    if (!snapshot)
+        return;
+
+    // Blend between the last two updates so motion stays smooth between ticks
+    const RenderState& prev = snapshot->previous;
+    const RenderState& curr = snapshot->current;
+    double t = snapshot->Alpha(FrameClock::now());
+    double sunLat = prev.sunLat + angleDiff(prev.sunLat, curr.sunLat) * t;
+    double sunLon = prev.sunLon + angleDiff(prev.sunLon, curr.sunLon) * t;
+    double moonLat = prev.moonLat + angleDiff(prev.moonLat, curr.moonLat) * t;
+    double moonLon = prev.moonLon + angleDiff(prev.moonLon, curr.moonLon) * t;
+    float sunPropAngle = prev.sunPropAngle + (curr.sunPropAngle - prev.sunPropAngle) * (float)t;
+    float lightBoost = prev.lightBoost + (curr.lightBoost - prev.lightBoost) * (float)t;
+    if (t < 1.0)
+        requestRedraw();
+
 	// Select our shader program
     program->Use();
 	
@@ -115,23 +179,17 @@ void LightScene::drawOverride()
     program->SetTexture2(*LonLatLookupTexture);
     
     // Set some additional uniforms our special shader uses
-    program->SetUniform("uSunPropigationRad", sunPropAngleCurrent * (float)(M_PI / 180.0));
-    {
-        double lat, lon;
-        astro.GetSolarPoint(TimeService::GetSceneTimeAsJulianDate(), lat, lon);
-        program->SetUniform("uLightBoost", lightAdjustEnabled ? astro.GetLightBoost(lat, lon) : 0.0f);
-    }
+    program->SetUniform("uSunPropigationRad", sunPropAngle * (float)(M_PI / 180.0));
+    program->SetUniform("uLightBoost", lightBoost);
     
     program->SetUniform("uDrawSun", true );
     program->SetUniform("uDrawMoon", true );
     
     // Send the sun's current location to the shader program
-    program->SetUniform("uSunLonLat", (float)(sunCurrentLon * (M_PI / 180.0)), (float)(sunCurrentLat * (M_PI / 180.0)));
+    program->SetUniform("uSunLonLat", (float)(sunLon * (M_PI / 180.0)), (float)(sunLat * (M_PI / 180.0)));
     
     // Do the same for the moon
-    double lat, lon;
-    astro.GetLunarPoint(TimeService::GetSceneTimeAsJulianDate(), lat, lon);
-    program->SetUniform("uMoonLonLat", (float)(lon * (M_PI / 180.0)), (float)(lat * (M_PI / 180.0)));
+    program->SetUniform("uMoonLonLat", (float)(moonLon * (M_PI / 180.0)), (float)(moonLat * (M_PI / 180.0)));
     
     // Finally, setup the main billboard render
     glVertexAttribPointer(
@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <ctime>
+#include <algorithm>
 
 
 MapTimeScene::MapTimeScene() : Scene(SceneType::Overlay, SceneLifetime::Manual)
@@ -10,6 +11,9 @@ MapTimeScene::MapTimeScene() : Scene(SceneType::Overlay, SceneLifetime::Manual)
 	Elements.push_back(&_monthLabel);
 	Elements.push_back(&_dayLabel);
 	Elements.push_back(&_yearLabel);
+
+  // Updates are scheduled for when the minute rolls over instead
+  setRefreshRate(0);
 }
 
 MapTimeScene::~MapTimeScene()
@@ -83,4 +87,8 @@ void MapTimeScene::updateOverride()
     _yearLabel.SetPosition(188, 16);
     _yearLabel.SetAlignment(HAlign::Right);
   }
+
+  // Come back when the clock needs to change, which is sooner when scene time runs fast
+  double secondsToNextMinute = (60 - nowLocal.tm_sec) / std::max(TimeService::GetSceneTimeMultiplier(), 1.0);
+  wakeAt(FrameClock::now() + std::chrono::duration_cast<FrameDuration>(fractionalSeconds(secondsToNextMinute)));
 }
@@ -0,0 +1,202 @@
+#include "MetricsService.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <fmt/format.h>
+
+using json = nlohmann::json;
+
+static std::mutex metricsMutex;
+static std::map<std::string, std::unique_ptr<MetricsPhase>> phases;
+static std::map<std::string, std::unique_ptr<std::atomic<uint64_t>>> counters;
+
+MetricsPhase::MetricsPhase(const std::string& name) :
+    name_(name),
+    count_(0),
+    totalNanoseconds_(0),
+    maxNanoseconds_(0)
+{
+    for (auto& bucket : buckets_)
+    {
+        bucket = 0;
+    }
+    for (auto& sample : recent_)
+    {
+        sample = 0;
+    }
+}
+
+const std::string& MetricsPhase::Name() const
+{
+    return name_;
+}
+
+void MetricsPhase::Record(FrameDuration duration)
+{
+    uint64_t ns = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    uint32_t us = (uint32_t)std::min<uint64_t>(ns / 1000, UINT32_MAX);
+
+    uint64_t index = count_.fetch_add(1, std::memory_order_relaxed);
+    recent_[index % RING_SIZE].store(us, std::memory_order_relaxed);
+    totalNanoseconds_.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = maxNanoseconds_.load(std::memory_order_relaxed);
+    while (ns > max && !maxNanoseconds_.compare_exchange_weak(max, ns, std::memory_order_relaxed));
+
+    size_t bucket = std::lower_bound(BUCKET_BOUNDS_US.begin(), BUCKET_BOUNDS_US.end(), us) - BUCKET_BOUNDS_US.begin();
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+MetricsPhase::Summary MetricsPhase::Read() const
+{
+    Summary summary;
+    summary.count = count_.load(std::memory_order_relaxed);
+    summary.totalMicroseconds = totalNanoseconds_.load(std::memory_order_relaxed) / 1000.0;
+    summary.maxMicroseconds = maxNanoseconds_.load(std::memory_order_relaxed) / 1000.0;
+    for (size_t i=0; i < BUCKET_COUNT; i++)
+    {
+        summary.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+
+    size_t recentCount = std::min<uint64_t>(summary.count, RING_SIZE);
+    summary.recentMicroseconds.reserve(recentCount);
+    for (size_t i=0; i < recentCount; i++)
+    {
+        summary.recentMicroseconds.push_back(recent_[i].load(std::memory_order_relaxed));
+    }
+    return summary;
+}
+
+MetricsTimer::MetricsTimer(MetricsPhase& phase) :
+    phase_(phase),
+    start_(FrameClock::now())
+{
+}
+
+MetricsTimer::~MetricsTimer()
+{
+    phase_.Record(FrameClock::now() - start_);
+}
+
+MetricsPhase& MetricsService::Phase(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    auto& phase = phases[name];
+    if (phase == nullptr)
+    {
+        phase = std::make_unique<MetricsPhase>(name);
+    }
+    return *phase;
+}
+
+std::atomic<uint64_t>& MetricsService::Counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(metricsMutex);
+    auto& counter = counters[name];
+    if (counter == nullptr)
+    {
+        counter = std::make_unique<std::atomic<uint64_t>>(0);
+    }
+    return *counter;
+}
+
+json MetricsService::ToJson()
+{
+    std::lock_guard<std::mutex> lock(metricsMutex);
+
+    json phasesJson = json::object();
+    for (const auto& [name, phase] : phases)
+    {
+        MetricsPhase::Summary summary = phase->Read();
+
+        json p;
+        p["count"] = summary.count;
+        p["meanUs"] = summary.count > 0 ? summary.totalMicroseconds / summary.count : 0.0;
+        p["maxUs"] = summary.maxMicroseconds;
+
+        // Percentiles only cover the recent samples, so they follow changes quickly
+        std::vector<uint32_t>& recent = summary.recentMicroseconds;
+        std::sort(recent.begin(), recent.end());
+        auto percentile = [&](double p) -> uint32_t
+        {
+            if (recent.empty())
+                return 0;
+            size_t rank = (size_t)std::max(0.0, std::ceil(p * recent.size()) - 1.0);
+            return recent[std::min(rank, recent.size() - 1)];
+        };
+        p["recent"] = json
+        {
+            {"samples", recent.size()},
+            {"p50Us", percentile(0.50)},
+            {"p90Us", percentile(0.90)},
+            {"p99Us", percentile(0.99)}
+        };
+
+        json histogram = json::array();
+        for (size_t i=0; i < MetricsPhase::BUCKET_COUNT; i++)
+        {
+            json bucket;
+            if (i < MetricsPhase::BUCKET_BOUNDS_US.size())
+                bucket["leUs"] = MetricsPhase::BUCKET_BOUNDS_US[i];
+            else
+                bucket["leUs"] = nullptr;
+            bucket["count"] = summary.buckets[i];
+            histogram.push_back(bucket);
+        }
+        p["histogram"] = histogram;
+
+        phasesJson[name] = p;
+    }
+
+    json countersJson = json::object();
+    for (const auto& [name, counter] : counters)
+    {
+        countersJson[name] = counter->load(std::memory_order_relaxed);
+    }
+
+    json result;
+    result["phases"] = phasesJson;
+    result["counters"] = countersJson;
+    return result;
+}
+
+std::string MetricsService::ToPrometheus()
+{
+    std::lock_guard<std::mutex> lock(metricsMutex);
+
+    std::stringstream ss;
+    ss << "# HELP mantlemap_phase_duration_seconds Time spent in each phase of the frame.\n";
+    ss << "# TYPE mantlemap_phase_duration_seconds histogram\n";
+    for (const auto& [name, phase] : phases)
+    {
+        MetricsPhase::Summary summary = phase->Read();
+
+        // Buckets are cumulative in Prometheus. The count comes from the buckets too,
+        // so it always agrees with them even if a sample lands mid read.
+        uint64_t cumulative = 0;
+        for (size_t i=0; i < MetricsPhase::BUCKET_BOUNDS_US.size(); i++)
+        {
+            cumulative += summary.buckets[i];
+            ss << fmt::format("mantlemap_phase_duration_seconds_bucket{{phase=\"{}\",le=\"{}\"}} {}\n",
+                              name, MetricsPhase::BUCKET_BOUNDS_US[i] / 1e6, cumulative);
+        }
+        cumulative += summary.buckets.back();
+        ss << fmt::format("mantlemap_phase_duration_seconds_bucket{{phase=\"{}\",le=\"+Inf\"}} {}\n", name, cumulative);
+        ss << fmt::format("mantlemap_phase_duration_seconds_sum{{phase=\"{}\"}} {}\n", name, summary.totalMicroseconds / 1e6);
+        ss << fmt::format("mantlemap_phase_duration_seconds_count{{phase=\"{}\"}} {}\n", name, cumulative);
+    }
+
+    for (const auto& [name, counter] : counters)
+    {
+        // Prometheus names can't have dots in them
+        std::string metricName = "mantlemap_" + name + "_total";
+        std::replace(metricName.begin(), metricName.end(), '.', '_');
+        ss << fmt::format("# TYPE {} counter\n", metricName);
+        ss << fmt::format("{} {}\n", metricName, counter->load(std::memory_order_relaxed));
+    }
+    return ss.str();
+}
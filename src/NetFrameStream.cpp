@@ -0,0 +1,401 @@
+#include "NetFrameStream.hpp"
+#include "FrameRecording.hpp"
+#include "MetricsService.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+
+static const char NET_FRAME_MAGIC[4] = {'M', 'M', 'N', 'F'};
+static const size_t NET_FRAME_HEADER_SIZE = 18;
+static const size_t NET_FRAME_MAX_FRAGMENT = NET_FRAME_MAX_PACKET - NET_FRAME_HEADER_SIZE;
+
+static const uint8_t FRAME_KEY = 0;
+static const uint8_t FRAME_DELTA = 1;
+
+// Longest a client can go without a keyframe, so one that joins late or lost
+// a packet catches up even when nothing's changing
+static const auto KEYFRAME_MAX_AGE = std::chrono::seconds(1);
+
+// Frames this far behind the newest one are stragglers and get ignored. Anything
+// further back means the sender restarted and is counting from the start again.
+static const int32_t REORDER_WINDOW = 64;
+
+// Room for a few whole frames in flight, so bursts of fragments aren't dropped by the kernel
+static const int SOCKET_BUFFER_BYTES = 4 * 1024 * 1024;
+
+template <typename T>
+static void putValue(std::vector<uint8_t>& packet, size_t offset, T value)
+{
+    memcpy(packet.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static T getValue(const uint8_t* packet, size_t offset)
+{
+    T value;
+    memcpy(&value, packet + offset, sizeof(T));
+    return value;
+}
+
+NetFrameSender::NetFrameSender(const NetFrameTile& tile, int keyframeInterval) :
+    tile_(tile),
+    keyframeInterval_(std::max(keyframeInterval, 1)),
+    socket_(-1),
+    sequence_(0),
+    framesSinceKeyframe_(0),
+    keyframeNeeded_(true),
+    tileFrame_(tile.width * tile.height * 4),
+    previous_(tile.width * tile.height * 4),
+    packet_(NET_FRAME_MAX_PACKET),
+    framesSent_(0),
+    bytesSent_(0)
+{
+    if (tile.width <= 0 || tile.height <= 0 || tile.width > UINT16_MAX || tile.height > UINT16_MAX)
+    {
+        throw std::runtime_error(fmt::format("Can't stream a {}x{} tile to {}!", tile.width, tile.height, tile.address));
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* result = nullptr;
+    int err = getaddrinfo(tile.address.c_str(), std::to_string(tile.port).c_str(), &hints, &result);
+    if (err != 0 || result == nullptr)
+    {
+        throw std::runtime_error(fmt::format("Couldn't resolve net client {}: {}", tile.address, gai_strerror(err)));
+    }
+    address_.assign(reinterpret_cast<uint8_t*>(result->ai_addr), reinterpret_cast<uint8_t*>(result->ai_addr) + result->ai_addrlen);
+    socket_ = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    freeaddrinfo(result);
+
+    if (socket_ == -1)
+    {
+        throw std::runtime_error(fmt::format("Couldn't create a socket for net client {}: {}", tile.address, strerror(errno)));
+    }
+
+    // Best effort, the kernel caps this at net.core.wmem_max
+    setsockopt(socket_, SOL_SOCKET, SO_SNDBUF, &SOCKET_BUFFER_BYTES, sizeof(SOCKET_BUFFER_BYTES));
+}
+
+NetFrameSender::~NetFrameSender()
+{
+    if (socket_ != -1)
+    {
+        close(socket_);
+    }
+}
+
+void NetFrameSender::Send(const ImageRGBA& frame)
+{
+    assert(tile_.x >= 0 && tile_.y >= 0 && tile_.x + tile_.width <= frame.width() && tile_.y + tile_.height <= frame.height());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t tileRowBytes = tile_.width * 4;
+    for (int y=0; y < tile_.height; y++)
+    {
+        memcpy(tileFrame_.data() + y * tileRowBytes, frame.data() + ((tile_.y + y) * frame.width() + tile_.x) * 4, tileRowBytes);
+    }
+
+    auto now = FrameClock::now();
+    bool keyframe = keyframeDue(now);
+    if (!keyframe && tileFrame_ == previous_)
+        return;
+
+    sendTileFrame(keyframe, now);
+}
+
+void NetFrameSender::SendKeyframeIfDue()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // There's nothing to repeat until Send has seen a frame
+    if (sequence_ == 0)
+        return;
+
+    auto now = FrameClock::now();
+    if (!keyframeDue(now))
+        return;
+
+    // previous_ is always the last tile we tried to send
+    tileFrame_ = previous_;
+    sendTileFrame(true, now);
+}
+
+bool NetFrameSender::keyframeDue(FrameTimePoint now) const
+{
+    return keyframeNeeded_ || framesSinceKeyframe_ >= keyframeInterval_ || now - lastKeyframeTime_ >= KEYFRAME_MAX_AGE;
+}
+
+// Send tileFrame_, as a delta from previous_ or a keyframe, and make it the new previous_
+void NetFrameSender::sendTileFrame(bool keyframe, FrameTimePoint now)
+{
+    if (keyframe)
+    {
+        // Keyframes are deltas from black, so they decode without anything before them
+        std::fill(previous_.begin(), previous_.end(), 0);
+    }
+    payload_.clear();
+    EncodeFramePayload(tileFrame_.data(), previous_.data(), tile_.width, tile_.height, payload_);
+    std::swap(previous_, tileFrame_);
+    sequence_++;
+
+    if (!sendPayload(keyframe))
+    {
+        keyframeNeeded_ = true;
+        return;
+    }
+
+    if (keyframe)
+    {
+        keyframeNeeded_ = false;
+        framesSinceKeyframe_ = 0;
+        lastKeyframeTime_ = now;
+    }
+    framesSinceKeyframe_++;
+    framesSent_++;
+}
+
+bool NetFrameSender::sendPayload(bool keyframe)
+{
+    static std::atomic<uint64_t>& bytesSentCounter = MetricsService::Counter("net.bytesSent");
+    static std::atomic<uint64_t>& framesDroppedCounter = MetricsService::Counter("net.framesDropped");
+
+    size_t fragments = std::max<size_t>((payload_.size() + NET_FRAME_MAX_FRAGMENT - 1) / NET_FRAME_MAX_FRAGMENT, 1);
+    if (fragments > UINT16_MAX)
+    {
+        throw std::runtime_error("Frame is too big to stream!");
+    }
+
+    memcpy(packet_.data(), NET_FRAME_MAGIC, sizeof(NET_FRAME_MAGIC));
+    putValue<uint32_t>(packet_, 4, sequence_);
+    putValue<uint8_t>(packet_, 8, keyframe ? FRAME_KEY : FRAME_DELTA);
+    putValue<uint8_t>(packet_, 9, 0);
+    putValue<uint16_t>(packet_, 12, fragments);
+    putValue<uint16_t>(packet_, 14, tile_.width);
+    putValue<uint16_t>(packet_, 16, tile_.height);
+
+    for (size_t i=0; i < fragments; i++)
+    {
+        size_t offset = i * NET_FRAME_MAX_FRAGMENT;
+        size_t length = std::min(NET_FRAME_MAX_FRAGMENT, payload_.size() - offset);
+        putValue<uint16_t>(packet_, 10, i);
+        memcpy(packet_.data() + NET_FRAME_HEADER_SIZE, payload_.data() + offset, length);
+
+        // Never wait on the network. A full buffer or an absent client just loses the frame.
+        ssize_t sent = sendto(socket_, packet_.data(), NET_FRAME_HEADER_SIZE + length, MSG_DONTWAIT,
+                              reinterpret_cast<const sockaddr*>(address_.data()), address_.size());
+        if (sent < 0)
+        {
+            framesDroppedCounter++;
+            return false;
+        }
+        bytesSent_ += sent;
+        bytesSentCounter += sent;
+    }
+    return true;
+}
+
+const NetFrameTile& NetFrameSender::Tile() const
+{
+    return tile_;
+}
+
+uint64_t NetFrameSender::FramesSent() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return framesSent_;
+}
+
+uint64_t NetFrameSender::BytesSent() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytesSent_;
+}
+
+NetFrameReceiver::NetFrameReceiver(int port, int width, int height) :
+    socket_(-1),
+    width_(width),
+    height_(height),
+    sequence_(0),
+    type_(FRAME_KEY),
+    assembling_(false),
+    fragmentsMissing_(0),
+    current_(width * height * 4),
+    haveKeyframe_(false),
+    lastSequence_(0),
+    sizeWarningShown_(false),
+    framesReceived_(0),
+    framesLost_(0)
+{
+    socket_ = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_ == -1)
+    {
+        throw std::runtime_error(fmt::format("Couldn't create a socket to receive frames: {}", strerror(errno)));
+    }
+
+    int reuse = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, &SOCKET_BUFFER_BYTES, sizeof(SOCKET_BUFFER_BYTES));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        int err = errno;
+        close(socket_);
+        throw std::runtime_error(fmt::format("Couldn't listen for frames on port {}: {}", port, strerror(err)));
+    }
+}
+
+NetFrameReceiver::~NetFrameReceiver()
+{
+    close(socket_);
+}
+
+bool NetFrameReceiver::Receive(ImageRGBA& frame, FrameDuration timeout)
+{
+    if (frame.width() != width_ || frame.height() != height_)
+    {
+        throw std::runtime_error("Frame size doesn't match the receiver!");
+    }
+
+    uint8_t packet[NET_FRAME_MAX_PACKET];
+    FrameTimePoint deadline = FrameClock::now() + timeout;
+    while (true)
+    {
+        // Take everything that's already here before waiting for more
+        ssize_t size;
+        while ((size = recv(socket_, packet, sizeof(packet), MSG_DONTWAIT)) > 0)
+        {
+            if (handlePacket(packet, size))
+            {
+                memcpy(frame.data(), current_.data(), current_.size());
+                return true;
+            }
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - FrameClock::now());
+        if (remaining.count() <= 0)
+            return false;
+
+        pollfd fd = { socket_, POLLIN, 0 };
+        if (poll(&fd, 1, remaining.count()) <= 0)
+            return false;
+    }
+}
+
+bool NetFrameReceiver::handlePacket(const uint8_t* packet, size_t size)
+{
+    if (size < NET_FRAME_HEADER_SIZE || memcmp(packet, NET_FRAME_MAGIC, sizeof(NET_FRAME_MAGIC)) != 0)
+        return false;
+
+    uint32_t sequence = getValue<uint32_t>(packet, 4);
+    uint8_t type = getValue<uint8_t>(packet, 8);
+    uint16_t index = getValue<uint16_t>(packet, 10);
+    uint16_t count = getValue<uint16_t>(packet, 12);
+    uint16_t width = getValue<uint16_t>(packet, 14);
+    uint16_t height = getValue<uint16_t>(packet, 16);
+
+    if (width != width_ || height != height_)
+    {
+        if (!sizeWarningShown_)
+        {
+            fprintf(stderr, "Getting %dx%d frames but the display is configured for %dx%d, ignoring them.\n", width, height, width_, height_);
+            sizeWarningShown_ = true;
+        }
+        return false;
+    }
+
+    if (type > FRAME_DELTA || count == 0 || index >= count)
+        return false;
+
+    if (!assembling_ || sequence != sequence_)
+    {
+        // Stragglers from a frame we've already finished or given up on
+        int32_t behind = (int32_t)(sequence_ - sequence);
+        if (behind > 0 && behind < REORDER_WINDOW)
+            return false;
+
+        if (assembling_)
+        {
+            framesLost_++;
+        }
+        sequence_ = sequence;
+        type_ = type;
+        fragments_.assign(count, std::vector<uint8_t>());
+        fragmentReceived_.assign(count, false);
+        fragmentsMissing_ = count;
+        assembling_ = true;
+    }
+
+    if (count != fragments_.size() || fragmentReceived_[index])
+        return false;
+
+    fragments_[index].assign(packet + NET_FRAME_HEADER_SIZE, packet + size);
+    fragmentReceived_[index] = true;
+    if (--fragmentsMissing_ > 0)
+        return false;
+
+    assembling_ = false;
+    return completeFrame();
+}
+
+bool NetFrameReceiver::completeFrame()
+{
+    payload_.clear();
+    for (const auto& fragment : fragments_)
+    {
+        payload_.insert(payload_.end(), fragment.begin(), fragment.end());
+    }
+
+    if (type_ == FRAME_KEY)
+    {
+        std::fill(current_.begin(), current_.end(), 0);
+    }
+    else if (!haveKeyframe_ || sequence_ != lastSequence_ + 1)
+    {
+        // Something in between went missing, so this can't be applied. Wait for a keyframe.
+        haveKeyframe_ = false;
+        framesLost_++;
+        return false;
+    }
+
+    try
+    {
+        DecodeFramePayload(payload_.data(), payload_.size(), current_.data(), width_, height_);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Dropped a streamed frame: %s\n", e.what());
+        haveKeyframe_ = false;
+        framesLost_++;
+        return false;
+    }
+
+    haveKeyframe_ = true;
+    lastSequence_ = sequence_;
+    framesReceived_++;
+    return true;
+}
+
+uint64_t NetFrameReceiver::FramesReceived() const
+{
+    return framesReceived_;
+}
+
+uint64_t NetFrameReceiver::FramesLost() const
+{
+    return framesLost_;
+}
@@ -0,0 +1,170 @@
+#include "PanelLayout.hpp"
+#include "ConfigService.hpp"
+static auto& config = ConfigService::global;
+
+#include <cstring>
+#include <stdexcept>
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+
+static const int DEFAULT_PANEL_COLS = 64;
+static const int DEFAULT_PANEL_ROWS = 32;
+static const int DEFAULT_CHAIN_LENGTH = 3;
+static const int DEFAULT_PARALLEL = 3;
+
+PanelLayout::PanelLayout(int cols, int rows, int chainLength, int parallel,
+                         const std::vector<PanelPlacement>& placements,
+                         int logicalWidth, int logicalHeight) :
+    cols_(cols),
+    rows_(rows),
+    chainLength_(chainLength),
+    parallel_(parallel),
+    logicalWidth_(logicalWidth),
+    logicalHeight_(logicalHeight)
+{
+    if (cols <= 0 || rows <= 0 || chainLength <= 0 || parallel <= 0)
+    {
+        throw std::runtime_error("LED panel size, chain length and parallel chains must all be positive!");
+    }
+
+    int panelCount = chainLength * parallel;
+    if (!placements.empty() && placements.size() != panelCount)
+    {
+        throw std::runtime_error(fmt::format("The LED panel layout places {} panels but there are {}!", placements.size(), panelCount));
+    }
+
+    indexMap_.assign(NativeWidth() * NativeHeight(), -1);
+    for (int panel=0; panel < panelCount; panel++)
+    {
+        int nativeX = (panel % chainLength) * cols;
+        int nativeY = (panel / chainLength) * rows;
+
+        // Without a layout, panels sit where they are in the native buffer
+        PanelPlacement place = placements.empty() ? PanelPlacement{nativeX, nativeY, 0} : placements[panel];
+        int rotation = ((place.rotation % 360) + 360) % 360;
+        if (rotation % 90 != 0)
+        {
+            throw std::runtime_error(fmt::format("LED panel {} is rotated {} degrees, which isn't a right angle!", panel, place.rotation));
+        }
+
+        for (int v=0; v < rows; v++)
+        {
+            for (int u=0; u < cols; u++)
+            {
+                int x, y;
+                switch (rotation)
+                {
+                    case 0:   x = u;             y = v;             break;
+                    case 90:  x = rows - 1 - v;  y = u;             break;
+                    case 180: x = cols - 1 - u;  y = rows - 1 - v;  break;
+                    default:  x = v;             y = cols - 1 - u;  break;
+                }
+                x += place.x;
+                y += place.y;
+
+                if (x >= 0 && x < logicalWidth && y >= 0 && y < logicalHeight)
+                {
+                    indexMap_[(nativeY + v) * NativeWidth() + nativeX + u] = y * logicalWidth + x;
+                }
+            }
+        }
+    }
+}
+
+PanelLayout PanelLayout::FromConfig()
+{
+    // The panels can't be rewired while we're running, so these only apply at startup
+    int cols = config.GetConfigValue("ledPanel.cols", DEFAULT_PANEL_COLS);
+    int rows = config.GetConfigValue("ledPanel.rows", DEFAULT_PANEL_ROWS);
+    int chainLength = config.GetConfigValue("ledPanel.chainLength", DEFAULT_CHAIN_LENGTH);
+    int parallel = config.GetConfigValue("ledPanel.parallel", DEFAULT_PARALLEL);
+    nlohmann::json layout = config.GetConfigValue("ledPanel.layout", nlohmann::json::array());
+
+    std::vector<PanelPlacement> placements;
+    if (layout.is_array())
+    {
+        for (const auto& entry : layout)
+        {
+            placements.push_back({ entry.value("x", 0), entry.value("y", 0), entry.value("rotation", 0) });
+        }
+    }
+
+    return PanelLayout(cols, rows, chainLength, parallel, placements, config.width(), config.height());
+}
+
+int PanelLayout::Cols() const
+{
+    return cols_;
+}
+
+int PanelLayout::Rows() const
+{
+    return rows_;
+}
+
+int PanelLayout::ChainLength() const
+{
+    return chainLength_;
+}
+
+int PanelLayout::Parallel() const
+{
+    return parallel_;
+}
+
+int PanelLayout::NativeWidth() const
+{
+    return cols_ * chainLength_;
+}
+
+int PanelLayout::NativeHeight() const
+{
+    return rows_ * parallel_;
+}
+
+bool PanelLayout::IsIdentity() const
+{
+    if (NativeWidth() != logicalWidth_ || NativeHeight() != logicalHeight_)
+        return false;
+
+    for (int i=0; i < indexMap_.size(); i++)
+    {
+        if (indexMap_[i] != i)
+            return false;
+    }
+    return true;
+}
+
+ImageRGBA PanelLayout::BuildLookup() const
+{
+    ImageRGBA lookup(NativeWidth(), NativeHeight());
+    uint8_t* entry = lookup.data();
+    for (int32_t index : indexMap_)
+    {
+        if (index < 0)
+        {
+            memset(entry, 0xFF, 4);
+        }
+        else
+        {
+            int x = index % logicalWidth_;
+            int y = index / logicalWidth_;
+            entry[0] = x & 0xFF;
+            entry[1] = x >> 8;
+            entry[2] = y & 0xFF;
+            entry[3] = y >> 8;
+        }
+        entry += 4;
+    }
+    return lookup;
+}
+
+void PanelLayout::Remap(const ImageRGBA& logical, ImageRGBA& native) const
+{
+    const uint32_t* in = reinterpret_cast<const uint32_t*>(logical.data());
+    uint32_t* out = reinterpret_cast<uint32_t*>(native.data());
+    for (size_t i=0; i < indexMap_.size(); i++)
+    {
+        out[i] = indexMap_[i] < 0 ? 0 : in[indexMap_[i]];
+    }
+}
@@ -1,6 +1,7 @@
 #include "PhysicsScene.hpp"
 #include "GfxProgram.hpp"
 #include "Utils.hpp"
+#include "FrameGovernor.hpp"
 #include "ConfigService.hpp"
 static auto& config = ConfigService::global;
 
@@ -21,6 +22,8 @@ PhysicsScene::PhysicsScene() : Scene(SceneType::Base, SceneLifetime::Manual),
     bgFill.AddPoint({{-config.width() / 2.0f, config.height() / 2.0f,0},{}});
     bgFill.SetLocation(config.width() / 2.0f, config.height() / 2.0f);
     bgFill.SetColor({0,0,0,0.03});
+
+    setRefreshRate(60.0);
 }
 
 void PhysicsScene::showOverride()
@@ -37,6 +40,9 @@ void PhysicsScene::showOverride()
         points[i].velocity = Random(Position{-1.0f, -1.0f, -1.0f}, Position{1.0f, 1.0f, 1.0f});
         points[i].color = Random(HSVColor(0.0f, 0.0f, 0.1f, 1.0f), HSVColor(360.0f, 0.8f, 0.8f, 1.0f));
     }
+
+    // Don't blend from wherever the particles were the last time we were shown
+    renderState.Publish({points, updateCounter}, false);
 }
 
 PhysicsScene::~PhysicsScene()
@@ -60,6 +66,12 @@ void PhysicsScene::initGLOverride()
     }
 }
 
+void PhysicsScene::releaseGLOverride()
+{
+    program.reset();
+    bgFill.ReleaseGL();
+}
+
 void PhysicsScene::drawOverride()
 {
     clearBeforeDraw = false;
@@ -69,14 +81,33 @@ void PhysicsScene::drawOverride()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glDisable(GL_BLEND);
 
-    if (points.size() > 0)
+    auto snapshot = renderState.Latest();
+    if (!snapshot)
+        return;
+
+    // Blend particle positions between the last two updates
+    const auto& prev = snapshot->previous.points;
+    const auto& cur = snapshot->current.points;
+    float t = snapshot->Alpha(FrameClock::now());
+    if (t < 1.0f)
+        requestRedraw();
+    drawPoints = cur;
+    if (prev.size() == cur.size())
+    {
+        for (int i=0; i < drawPoints.size(); i++)
+        {
+            drawPoints[i].pos = prev[i].pos * (1.0f - t) + cur[i].pos * t;
+        }
+    }
+
+    if (drawPoints.size() > 0)
     {
         // Draw the particles
         program->Use();
 
         program->SetTint({0.5, 0.5, 1.0, 1.0});
 
-        float rY = ((float)updateCounter / 6000.0f) * M_PI * 2.0f;
+        float rY = ((float)snapshot->current.updateCounter / 6000.0f) * M_PI * 2.0f;
         program->SetModelTransform( Transform3D::FromTranslation(config.width()/2.0f, config.height()/2.0f, 0.0f) * 
                                     Transform3D::FromEuler(0, rY, 0) );
 
@@ -86,7 +117,7 @@ void PhysicsScene::drawOverride()
                     GL_FLOAT,           // type
                     GL_FALSE,           // normalized?
                     sizeof(PhysicsPoint),                  // stride
-                    points.data()         // underlying data
+                    drawPoints.data()         // underlying data
         );
         glEnableVertexAttribArray ( program->Attrib("aPosition") );
         
@@ -96,7 +127,7 @@ void PhysicsScene::drawOverride()
                             GL_FLOAT,           // type
                             GL_FALSE,           // normalized?
                             sizeof(PhysicsPoint),   // stride
-                            ((float*)points.data())+3       // underlying data
+                            ((float*)drawPoints.data())+3       // underlying data
         );
         glEnableVertexAttribArray(program->Attrib("aColor"));
 
@@ -106,12 +137,12 @@ void PhysicsScene::drawOverride()
                             GL_FLOAT,           // type
                             GL_FALSE,           // normalized?
                             sizeof(PhysicsPoint),   // stride
-                            ((float*)points.data())+7      // underlying data
+                            ((float*)drawPoints.data())+7      // underlying data
         );
         glEnableVertexAttribArray(program->Attrib("aPointSize"));
 
         // Draw the points!
-        glDrawArrays(GL_POINTS, 0, points.size());
+        glDrawArrays(GL_POINTS, 0, drawPoints.size());
     }
 }
 
@@ -168,13 +199,17 @@ void PhysicsScene::updateOverride()
         {}
     };
 
+    // Every particle pulls on every other, so fewer of them is the quickest way
+    // to a cheaper update when the frame governor asks for less detail
+    size_t activePoints = std::max<size_t>(1, (size_t)(points.size() * FrameGovernor::QualityScale()));
+
     Vec3 a1, a2;
-    for (int i=0; i < points.size(); i++)
+    for (int i=0; i < activePoints; i++)
     {
         if (points[i].mass == 0)
             continue;
 
-        for (int j=i+1; j < points.size(); j++)
+        for (int j=i+1; j < activePoints; j++)
         {
             if (points[j].mass == 0)
                 continue;
@@ -199,4 +234,19 @@ void PhysicsScene::updateOverride()
         // Move the point for this time step
         points[i].pos += points[i].velocity * dT;
     }
+
+    // The rest aren't drawn, but keep them moving under the centering pull alone so
+    // they come back somewhere plausible when the governor steps back up, rather than
+    // popping in wherever they stopped
+    for (size_t i=activePoints; i < points.size(); i++)
+    {
+        if (points[i].mass == 0)
+            continue;
+
+        gravForce(points[i], phantom, a1, a2);
+        points[i].velocity += a1 * dT;
+        points[i].pos += points[i].velocity * dT;
+    }
+
+    renderState.Publish({std::vector<PhysicsPoint>(points.begin(), points.begin() + activePoints), updateCounter});
 }
@@ -0,0 +1,174 @@
+#include "PixelOps.hpp"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PIXELOPS_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXELOPS_SSE2
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define PIXELOPS_SSSE3
+#endif
+#endif
+
+// XXH64 (https://github.com/Cyan4973/xxHash), seed 0. Every bit of every word
+// goes through a multiply and rotate, so unlike a sum, changes in different
+// places can't cancel each other out. It's all 64 bit multiplies, which neither
+// NEON nor SSE2 has, so there's only the scalar version.
+static const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxhMergeRound(uint64_t acc, uint64_t val)
+{
+    acc ^= xxhRound(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t pixelChecksum(const uint8_t* data, size_t length)
+{
+    const uint8_t* ptr = data;
+    const uint8_t* end = data + length;
+    uint64_t h;
+
+    if (length >= 32)
+    {
+        // Four independent lanes keep the multipliers busy
+        uint64_t v1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = XXH_PRIME64_2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - XXH_PRIME64_1;
+        const uint8_t* limit = end - 32;
+        do
+        {
+            v1 = xxhRound(v1, read64(ptr));
+            v2 = xxhRound(v2, read64(ptr + 8));
+            v3 = xxhRound(v3, read64(ptr + 16));
+            v4 = xxhRound(v4, read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxhMergeRound(h, v1);
+        h = xxhMergeRound(h, v2);
+        h = xxhMergeRound(h, v3);
+        h = xxhMergeRound(h, v4);
+    }
+    else
+    {
+        h = XXH_PRIME64_5;
+    }
+
+    h += (uint64_t)length;
+
+    for (; ptr + 8 <= end; ptr += 8)
+    {
+        h ^= xxhRound(0, read64(ptr));
+        h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (ptr + 4 <= end)
+    {
+        uint32_t word;
+        memcpy(&word, ptr, 4);
+        h ^= (uint64_t)word * XXH_PRIME64_1;
+        h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        ptr += 4;
+    }
+    for (; ptr < end; ptr++)
+    {
+        h ^= (*ptr) * XXH_PRIME64_5;
+        h = rotl64(h, 11) * XXH_PRIME64_1;
+    }
+
+    // Avalanche
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool pixelRowsEqual(const uint8_t* a, const uint8_t* b, size_t length)
+{
+    size_t i = 0;
+
+#if defined(PIXELOPS_NEON)
+    // OR together the XOR of every block and check for any set bit once at the end
+    uint8x16_t diff = vdupq_n_u8(0);
+    for (; i + 16 <= length; i += 16)
+    {
+        diff = vorrq_u8(diff, veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+    }
+    uint64x2_t diff64 = vreinterpretq_u64_u8(diff);
+    if ((vgetq_lane_u64(diff64, 0) | vgetq_lane_u64(diff64, 1)) != 0)
+        return false;
+#elif defined(PIXELOPS_SSE2)
+    __m128i diff = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        diff = _mm_or_si128(diff, _mm_xor_si128(va, vb));
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF)
+        return false;
+#endif
+
+    return memcmp(a + i, b + i, length - i) == 0;
+}
+
+void rgbaToRgbRow(const uint8_t* rgba, uint8_t* rgb, size_t pixelCount)
+{
+    size_t i = 0;
+
+#if defined(PIXELOPS_NEON)
+    // De-interleaving loads and interleaving stores do the whole job, 16 pixels at a time
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x4_t px = vld4q_u8(rgba + i * 4);
+        uint8x16x3_t out = { { px.val[0], px.val[1], px.val[2] } };
+        vst3q_u8(rgb + i * 3, out);
+    }
+#elif defined(PIXELOPS_SSSE3)
+    // Shuffle each group of 4 pixels down to 12 bytes. Stores are 16 bytes wide,
+    // so stop while there's still room for the 4 byte overhang in the output.
+    const __m128i packRgb = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    for (; i + 6 <= pixelCount; i += 4)
+    {
+        __m128i px = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+        _mm_storeu_si128((__m128i*)(rgb + i * 3), _mm_shuffle_epi8(px, packRgb));
+    }
+#endif
+
+    for (; i < pixelCount; i++)
+    {
+        rgb[i * 3 + 0] = rgba[i * 4 + 0];
+        rgb[i * 3 + 1] = rgba[i * 4 + 1];
+        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+}
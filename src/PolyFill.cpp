@@ -30,6 +30,11 @@ PolyFill::~PolyFill()
 {
 }
 
+void PolyFill::ReleaseGL()
+{
+  _program.reset();
+}
+
 void PolyFill::SetPoints(const std::vector<Vertex>& points)
 {
   _points = points;
@@ -31,26 +31,35 @@ PolyLine::~PolyLine()
 {
 }
 
+void PolyLine::ReleaseGL()
+{
+  _program.reset();
+}
+
 void PolyLine::SetPoints(const std::vector<Vertex>& points)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _points = points;
   invalidateBuffers();
 }
 
 void PolyLine::AddPoint(const Vertex& point)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _points.push_back(point);
   invalidateBuffers();
 }
 
 void PolyLine::SetLocation(float x, float y)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _locX = x;
   _locY = y;
 }
 
 void PolyLine::Move(float dx, float dy)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _locX += dx;
   _locY += dy;
 }
@@ -58,11 +67,13 @@ void PolyLine::Move(float dx, float dy)
 
 void PolyLine::SetColor(Color color)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _color = color;
 }
 
 void PolyLine::SetThickness(float thickness)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _halfWidth = thickness / 2.0f;
   invalidateBuffers();
 }
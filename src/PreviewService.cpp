@@ -0,0 +1,246 @@
+#include "PreviewService.hpp"
+#include "ImageRGBA.hpp"
+#include "MetricsService.hpp"
+#include "TimeService.hpp"
+#include "ConfigService.hpp"
+static auto& config = ConfigService::global;
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+#include <fmt/format.h>
+
+static const int DEFAULT_PREVIEW_MAX_FPS = 10;
+static const int DEFAULT_PREVIEW_MAX_STREAMS = 2;
+static const int DEFAULT_PREVIEW_PNG_COMPRESSION = 1;
+
+// How long a snapshot request waits for a fresh frame before settling for the last one
+static const auto SNAPSHOT_WAIT = std::chrono::seconds(1);
+
+// How often an idle stream gets back to httplib so it can notice the client went away
+static const auto STREAM_POLL_INTERVAL = std::chrono::milliseconds(500);
+
+static const std::string STREAM_BOUNDARY = "mantlemapframe";
+
+typedef std::shared_ptr<const std::vector<uint8_t>> EncodedFrame;
+
+struct PreviewState
+{
+    std::mutex mutex;
+    std::condition_variable encodedReady;
+    bool stopping = false;
+
+    // Clients waiting for frames. Nothing is read back or encoded while this is zero.
+    std::atomic<int> viewers{0};
+    std::atomic<int> streams{0};
+
+    std::atomic<int> maxFps{DEFAULT_PREVIEW_MAX_FPS};
+    std::atomic<int> maxStreams{DEFAULT_PREVIEW_MAX_STREAMS};
+    std::atomic<int> pngCompression{DEFAULT_PREVIEW_PNG_COMPRESSION};
+
+    // Only touched on the bus thread
+    FrameTimePoint lastEncodeTime;
+
+    // Guarded by mutex. Swapped out whole, never modified, so whoever
+    // holds a reference can keep using it without the lock.
+    EncodedFrame encoded;
+    uint64_t encodedNumber = 0;
+
+    // Guarded by mutex, and dropped when the service goes, since the display may go with it
+    std::function<void()> requestFrame;
+
+    // Bus thread: turn the frame into a PNG that every client shares, if one is due
+    void Encode(const SharedFrame& frame)
+    {
+        static MetricsPhase& encodeMetrics = MetricsService::Phase("preview.encode");
+
+        auto now = FrameClock::now();
+        if (now - lastEncodeTime < std::chrono::seconds(1) / std::max(maxFps.load(), 1))
+            return;
+        lastEncodeTime = now;
+
+        EncodedFrame png;
+        {
+            MetricsTimer timer(encodeMetrics);
+            png = std::make_shared<const std::vector<uint8_t>>(frame->ToPng(pngCompression));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            encoded = std::move(png);
+            encodedNumber++;
+        }
+        encodedReady.notify_all();
+    }
+
+    // Wait for a frame newer than the given one. Returns null on timeout or shutdown.
+    EncodedFrame WaitForFrame(uint64_t after, uint64_t& number, FrameDuration timeout)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool ready = encodedReady.wait_for(lock, timeout, [&]()
+        {
+            return stopping || (encoded != nullptr && encodedNumber != after);
+        });
+        if (!ready || stopping)
+            return nullptr;
+
+        number = encodedNumber;
+        return encoded;
+    }
+
+    // Have the display publish a frame, even if nothing on it has changed
+    void RequestFrame()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (requestFrame)
+        {
+            requestFrame();
+        }
+    }
+
+    uint64_t LatestFrame(EncodedFrame& frame)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        frame = encoded;
+        return encodedNumber;
+    }
+};
+
+// Where one stream client is up to
+struct PreviewStreamClient
+{
+    uint64_t lastFrame = 0;
+    FrameTimePoint lastSent;
+    FrameDuration interval;
+};
+
+PreviewService::PreviewService(HttpService& http, DisplayDevice& display) :
+    state_(std::make_shared<PreviewState>())
+{
+    std::shared_ptr<PreviewState> state = state_;
+
+    settings_ = config.Subscribe([state](const ConfigUpdateEventArg& arg)
+    {
+        int value = state->maxFps;
+        if (arg.UpdateIfChanged("preview.maxFps", value, DEFAULT_PREVIEW_MAX_FPS))
+        {
+            state->maxFps = std::max(value, 1);
+        }
+
+        value = state->maxStreams;
+        if (arg.UpdateIfChanged("preview.maxStreams", value, DEFAULT_PREVIEW_MAX_STREAMS))
+        {
+            state->maxStreams = value;
+        }
+
+        value = state->pngCompression;
+        if (arg.UpdateIfChanged("preview.pngCompression", value, DEFAULT_PREVIEW_PNG_COMPRESSION))
+        {
+            state->pngCompression = std::clamp(value, 0, 9);
+        }
+    });
+
+    // Only the newest frame is worth encoding, and nothing is wanted (so the simulator
+    // window is spared reading frames back) while nobody's watching
+    frames_ = display.Frames().Subscribe("preview", FrameSubscriberOptions(),
+        [state](const SharedFrame& frame, FrameTimePoint time) { state->Encode(frame); },
+        [state]() { return state->viewers > 0; });
+    state->requestFrame = [&display]() { display.Frames().RequestFrame(); };
+
+    httplib::Server& srv = http.Server();
+
+    srv.Get("/display/snapshot", [state](const httplib::Request& req, httplib::Response& res)
+    {
+        EncodedFrame png;
+        uint64_t number = state->LatestFrame(png);
+
+        // Ask for a fresh frame. The display won't render one by itself if it's static
+        // or asleep, so have it redraw (or republish the blank) for us. If none comes
+        // in time, the last one we encoded is still what's showing.
+        state->viewers++;
+        state->RequestFrame();
+        EncodedFrame fresh = state->WaitForFrame(number, number, SNAPSHOT_WAIT);
+        state->viewers--;
+        if (fresh != nullptr)
+        {
+            png = fresh;
+        }
+
+        if (png == nullptr)
+        {
+            res.status = 503;
+            res.body = "Nothing has been displayed yet.";
+            return;
+        }
+
+        res.set_header("Cache-Control", "no-store");
+        res.set_content(std::string(png->begin(), png->end()), "image/png");
+    });
+
+    srv.Get("/display/stream", [state](const httplib::Request& req, httplib::Response& res)
+    {
+        int fps = state->maxFps;
+        if (req.has_param("fps"))
+        {
+            fps = std::clamp(atoi(req.get_param_value("fps").c_str()), 1, fps);
+        }
+
+        // Each stream ties up one of httplib's worker threads for as long as it's open
+        if (state->streams.fetch_add(1) >= state->maxStreams)
+        {
+            state->streams--;
+            res.status = 503;
+            res.body = "Too many preview streams are already open.";
+            return;
+        }
+        state->viewers++;
+        state->RequestFrame();
+
+        auto client = std::make_shared<PreviewStreamClient>();
+        client->interval = std::chrono::duration_cast<FrameDuration>(std::chrono::seconds(1)) / fps;
+
+        res.set_header("Cache-Control", "no-store");
+        res.set_chunked_content_provider(fmt::format("multipart/x-mixed-replace; boundary={}", STREAM_BOUNDARY),
+            [state, client](size_t offset, httplib::DataSink& sink)
+            {
+                static std::atomic<uint64_t>& framesSentCounter = MetricsService::Counter("preview.framesSent");
+
+                // Hold this client to its own frame rate, whatever the others are getting
+                std::this_thread::sleep_until(client->lastSent + client->interval);
+
+                uint64_t number;
+                EncodedFrame png = state->WaitForFrame(client->lastFrame, number, STREAM_POLL_INTERVAL);
+                if (png == nullptr)
+                {
+                    return !state->stopping;
+                }
+                client->lastFrame = number;
+                client->lastSent = FrameClock::now();
+
+                std::string header = fmt::format("--{}\r\nContent-Type: image/png\r\nContent-Length: {}\r\n\r\n", STREAM_BOUNDARY, png->size());
+                framesSentCounter++;
+                return sink.write(header.data(), header.size()) &&
+                       sink.write(reinterpret_cast<const char*>(png->data()), png->size()) &&
+                       sink.write("\r\n", 2);
+            },
+            [state](bool success)
+            {
+                state->viewers--;
+                state->streams--;
+            });
+    });
+}
+
+PreviewService::~PreviewService()
+{
+    frames_ = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->stopping = true;
+        state_->requestFrame = nullptr;
+    }
+    state_->encodedReady.notify_all();
+}
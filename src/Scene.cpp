@@ -1,8 +1,10 @@
 #include "Scene.hpp"
 #include "ConfigService.hpp"
 static auto& config = ConfigService::global;
+#include "MetricsService.hpp"
 
 #include <assert.h>
+#include <algorithm>
 #include <filesystem>
 #include <fmt/format.h>
 #include <nlohmann/json.hpp>
@@ -18,6 +20,13 @@ Scene::Scene(SceneType sceneType, SceneLifetime sceneLifetime)
   _sceneType = sceneType;
   _sceneLifetime = sceneLifetime;
   _sceneLifetimeSeconds = fractionalSeconds(10.0);
+  _lastUpdateTimeValid = false;
+  _updateDelta = FrameDuration::zero();
+  _refreshInterval = FrameDuration::zero();
+  _nextUpdateTime = FrameTimePoint::min();
+  _redrawRequested = false;
+  _updateMetrics = nullptr;
+  _drawMetrics = nullptr;
   clearBeforeDraw = true;
 }
 
@@ -28,63 +37,66 @@ Scene::~Scene()
 
 void Scene::RegisterEndpoints(HttpService& http)
 {
-    http.Server().Get(fmt::format("/scenes/{}", SceneName()), [=](const httplib::Request& req, httplib::Response& res) 
+    http.Server().Get(fmt::format("/scenes/{}", SceneName()), [=, &http](const httplib::Request& req, httplib::Response& res) 
     {
-        json sceneInfo = json::object();
-        
-        sceneInfo["name"] = SceneName();
-        sceneInfo["visible"] = Visible();
-        sceneInfo["sceneType"] = GetSceneType() == SceneType::Base ? "Base" : "Overlay";
-
-        const json& sceneDesc = config.GetConfigJson(fmt::format("scenes.{}", SceneName()));
-        for (const auto& kvp : sceneDesc.items())
+        http.RunOnMainThread([=]()
         {
-            sceneInfo[kvp.key()] = kvp.value();
-        }
+            json sceneInfo = json::object();
+            
+            sceneInfo["name"] = SceneName();
+            sceneInfo["visible"] = Visible();
+            sceneInfo["sceneType"] = GetSceneType() == SceneType::Base ? "Base" : "Overlay";
+
+            const json& sceneDesc = config.GetConfigJson(fmt::format("scenes.{}", SceneName()));
+            for (const auto& kvp : sceneDesc.items())
+            {
+                sceneInfo[kvp.key()] = kvp.value();
+            }
 
-        std::stringstream ss;
-        ss << std::setw(4) << sceneInfo;
-        res.body = ss.str();
+            std::stringstream ss;
+            ss << std::setw(4) << sceneInfo;
+            return HttpResult { 200, ss.str() };
+        }, res);
     });
 
-    http.Server().Patch(fmt::format("/scenes/{}", SceneName()), [=](const httplib::Request& req, httplib::Response& res) 
+    http.Server().Patch(fmt::format("/scenes/{}", SceneName()), [=, &http](const httplib::Request& req, httplib::Response& res) 
     {
         auto settingsPatch = json::parse(req.body);
 
-        for (auto& kvp : settingsPatch.items())
+        http.RunOnMainThread([=]()
         {
-            if (kvp.key() == "name" || 
-                kvp.key() == "visible" || 
-                kvp.key() == "sceneType" )
-                continue;
-
-            std::string key = fmt::format("scenes.{}.{}", SceneName(), kvp.key());
-
-            if (!config.HasKey(key))
+            for (auto& kvp : settingsPatch.items())
             {
-                res.status = 400;
-                res.body = fmt::format("Bad patch request, settings key {} is invalid.", kvp.key());
-                return;
+                if (kvp.key() == "name" || 
+                    kvp.key() == "visible" || 
+                    kvp.key() == "sceneType" )
+                    continue;
+
+                std::string key = fmt::format("scenes.{}.{}", SceneName(), kvp.key());
+
+                if (!config.HasKey(key))
+                {
+                    return HttpResult { 400, fmt::format("Bad patch request, settings key {} is invalid.", kvp.key()) };
+                }
+
+                if (!config.ValueTypeMatches(key, kvp.value()))
+                {
+                    return HttpResult { 400, fmt::format("Bad patch request, value {} was an incorrect type.", kvp.key()) };
+                }
             }
 
-            if (!config.ValueTypeMatches(key, kvp.value()))
+            for (auto& kvp : settingsPatch.items())
             {
-                res.status = 400;
-                res.body = fmt::format("Bad patch request, value {} was an incorrect type.", kvp.key());
-                return;
-            }
-        }
+                if (kvp.key() == "name" || 
+                    kvp.key() == "visible" || 
+                    kvp.key() == "sceneType" )
+                    continue;
 
-        for (auto& kvp : settingsPatch.items())
-        {
-            if (kvp.key() == "name" || 
-                kvp.key() == "visible" || 
-                kvp.key() == "sceneType" )
-                continue;
-
-            std::string key = fmt::format("scenes.{}.{}", SceneName(), kvp.key());
-            config.SetConfigValue(key, kvp.value());
-        }
+                std::string key = fmt::format("scenes.{}.{}", SceneName(), kvp.key());
+                config.SetConfigValue(key, kvp.value());
+            }
+            return HttpResult();
+        }, res);
     });
 
     registerEndpointsOverride(http);
@@ -119,6 +131,7 @@ void Scene::Reset(bool animate)
 {
   if (_sceneLifetime == SceneLifetime::Reset)
     Hide();
+  Wake();
   resetOverride(animate);
 }
 
@@ -129,6 +142,9 @@ void Scene::Show()
   {
     _isVisible = true;
     _showTime = std::chrono::system_clock::now();
+    // Don't count the time we spent hidden as one long update
+    _lastUpdateTimeValid = false;
+    Wake();
     showOverride();
   }
 }
@@ -147,8 +163,23 @@ void Scene::Update()
         return;
       }
     }
+
+    FrameTimePoint now = FrameClock::now();
+    _updateDelta = _lastUpdateTimeValid ? now - _lastUpdateTime : FrameDuration::zero();
+    _lastUpdateTime = now;
+    _lastUpdateTimeValid = true;
+
+    // Schedule the next update before updateOverride so it can call wakeAt or change the rate
+    _nextUpdateTime = _refreshInterval == FrameDuration::max() ? FrameTimePoint::max() : now + _refreshInterval;
     
-    updateOverride();
+    // The name isn't available in the constructor, so look the phase up the first time through
+    if (_updateMetrics == nullptr)
+      _updateMetrics = &MetricsService::Phase(fmt::format("scene.{}.update", SceneName()));
+    {
+      MetricsTimer timer(*_updateMetrics);
+      updateOverride();
+    }
+    requestRedraw();
   }
 }
 
@@ -159,6 +190,7 @@ void Scene::Hide()
   {
     _isVisible = false;
     hideOverride();
+    requestRedraw();
   }
 }
 
@@ -167,6 +199,10 @@ void Scene::Draw()
 {
   if (_isVisible)
   {
+    if (_drawMetrics == nullptr)
+      _drawMetrics = &MetricsService::Phase(fmt::format("scene.{}.draw", SceneName()));
+    MetricsTimer timer(*_drawMetrics);
+
     initGL();
     print_if_glerror("InitGL for scene " << SceneName());
 
@@ -182,9 +218,20 @@ void Scene::Draw()
   }
 }
 
+void Scene::ReleaseGL()
+{
+  releaseGLOverride();
+  for (auto element : Elements)
+  {
+    element->ReleaseGL();
+  }
+  _initGLDone = false;
+}
+
 void Scene::OnSceneChanged(std::string baseSceneName)
 {
   BaseSceneName = baseSceneName;
+  Wake();
   baseSceneChangedOverride(BaseSceneName);
 }
 
@@ -193,6 +240,11 @@ void Scene::initGLOverride()
   // Do nothing, child objects should override
 }
 
+void Scene::releaseGLOverride()
+{
+  // Nothing to do, child objects that load their own GL resources should override
+}
+
 void Scene::registerEndpointsOverride(HttpService& http)
 {
   // Do nothing, child objects should override
@@ -243,6 +295,62 @@ SceneType Scene::GetSceneType()
   return _sceneType;
 }
 
+double Scene::updateDelta()
+{
+  return std::chrono::duration_cast<fractionalSeconds>(_updateDelta).count();
+}
+
+void Scene::Wake()
+{
+  wakeAt(FrameTimePoint::min());
+  requestRedraw();
+}
+
+FrameTimePoint Scene::NextUpdateTime()
+{
+  FrameTimePoint next = _nextUpdateTime;
+  
+  // Timed scenes need an update when their time is up so they can hide themselves
+  if (_isVisible && _sceneLifetime == SceneLifetime::Timed)
+  {
+    auto remaining = (_showTime + _sceneLifetimeSeconds) - std::chrono::system_clock::now();
+    FrameTimePoint hideTime = FrameClock::now() + std::chrono::duration_cast<FrameDuration>(remaining);
+    next = std::min(next, hideTime);
+  }
+  return next;
+}
+
+bool Scene::TakeRedrawRequest()
+{
+  return _redrawRequested.exchange(false);
+}
+
+void Scene::setRefreshRate(double hz)
+{
+  _refreshInterval = hz > 0.0 ? 
+                      std::chrono::duration_cast<FrameDuration>(fractionalSeconds(1.0 / hz)) : 
+                      FrameDuration::max();
+
+  // Pull the next update in if the new rate is faster
+  if (_lastUpdateTimeValid && _refreshInterval != FrameDuration::max())
+  {
+    wakeAt(_lastUpdateTime + _refreshInterval);
+  }
+}
+
+void Scene::wakeAt(FrameTimePoint time)
+{
+  FrameTimePoint next = _nextUpdateTime;
+  while (time < next && !_nextUpdateTime.compare_exchange_weak(next, time))
+  {
+  }
+}
+
+void Scene::requestRedraw()
+{
+  _redrawRequested = true;
+}
+
 // Load an image using libpng and insert it straight into a texture
 std::unique_ptr<GfxTexture> Scene::loadTexture(std::string resourceName)
 {
@@ -18,6 +18,11 @@ void SceneElement::Draw()
     drawInternal();
 }
 
+void SceneElement::ReleaseGL()
+{
+    // Nothing to do, elements with GPU resources should override
+}
+
 // Load an image using libpng and insert it straight into a texture
 std::unique_ptr<GfxTexture> SceneElement::loadTexture(std::string resourceName)
 {
@@ -0,0 +1,232 @@
+#include "SharedFrameRing.hpp"
+#include "TimeService.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <fmt/format.h>
+
+// How many times Read tries to get a clean copy before giving up on a frame
+static const int READ_ATTEMPTS = 3;
+
+static size_t roundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static size_t bytesPerPixel(SharedFrameFormat format)
+{
+    return format == SharedFrameFormat::RGB8 ? 3 : 4;
+}
+
+static SharedFrameSlotHeader* slotAt(uint8_t* base, const SharedFrameRingHeader& header, uint64_t frameNumber)
+{
+    return reinterpret_cast<SharedFrameSlotHeader*>(base + header.headerSize + (frameNumber % header.slotCount) * header.slotStride);
+}
+
+SharedFrameRingWriter::SharedFrameRingWriter(const std::string& name, int width, int height, SharedFrameFormat format, int slotCount) :
+    name_(name),
+    writing_(nullptr),
+    nextFrame_(1)
+{
+    if (width <= 0 || height <= 0 || slotCount <= 0)
+    {
+        throw std::runtime_error("Shared frame ring needs a size and at least one slot!");
+    }
+
+    uint32_t stride = width * bytesPerPixel(format);
+    uint64_t frameSize = (uint64_t)stride * height;
+    size_t headerSize = roundUp(sizeof(SharedFrameRingHeader), 64);
+    size_t slotStride = roundUp(sizeof(SharedFrameSlotHeader) + frameSize, 64);
+    size_ = headerSize + slotStride * slotCount;
+
+    // Start from a clean segment so old readers can't mistake it for ours
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error(fmt::format("Couldn't create shared frame ring {}: {}", name_, strerror(errno)));
+    }
+
+    if (ftruncate(fd, size_) != 0)
+    {
+        int err = errno;
+        close(fd);
+        shm_unlink(name_.c_str());
+        throw std::runtime_error(fmt::format("Couldn't size shared frame ring {}: {}", name_, strerror(err)));
+    }
+
+    void* mapping = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(name_.c_str());
+        throw std::runtime_error(fmt::format("Couldn't map shared frame ring {}: {}", name_, strerror(errno)));
+    }
+    base_ = static_cast<uint8_t*>(mapping);
+
+    header_ = new (base_) SharedFrameRingHeader();
+    header_->version = SHARED_FRAME_RING_VERSION;
+    header_->width = width;
+    header_->height = height;
+    header_->format = format;
+    header_->stride = stride;
+    header_->slotCount = slotCount;
+    header_->headerSize = headerSize;
+    header_->slotStride = slotStride;
+    header_->frameSize = frameSize;
+    header_->writerPid = getpid();
+    header_->latestFrame.store(0, std::memory_order_relaxed);
+
+    for (int i=0; i < slotCount; i++)
+    {
+        SharedFrameSlotHeader* slot = new (base_ + headerSize + i * slotStride) SharedFrameSlotHeader();
+        slot->sequence.store(0, std::memory_order_relaxed);
+        slot->frameNumber.store(0, std::memory_order_relaxed);
+        slot->timestampNs.store(0, std::memory_order_relaxed);
+    }
+
+    // Readers check the magic number first, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = SHARED_FRAME_RING_MAGIC;
+}
+
+SharedFrameRingWriter::~SharedFrameRingWriter()
+{
+    munmap(base_, size_);
+    shm_unlink(name_.c_str());
+}
+
+uint8_t* SharedFrameRingWriter::BeginWrite()
+{
+    writing_ = slotAt(base_, *header_, nextFrame_);
+
+    // Odd sequence first, so readers that race with the write below can tell
+    uint64_t sequence = writing_->sequence.load(std::memory_order_relaxed);
+    writing_->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    writing_->frameNumber.store(nextFrame_, std::memory_order_relaxed);
+    return reinterpret_cast<uint8_t*>(writing_) + sizeof(SharedFrameSlotHeader);
+}
+
+void SharedFrameRingWriter::EndWrite()
+{
+    if (writing_ == nullptr)
+        return;
+
+    writing_->timestampNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(FrameClock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+    writing_->sequence.store(writing_->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    header_->latestFrame.store(nextFrame_, std::memory_order_release);
+
+    writing_ = nullptr;
+    nextFrame_++;
+}
+
+const SharedFrameRingHeader& SharedFrameRingWriter::Header() const
+{
+    return *header_;
+}
+
+SharedFrameRingReader::SharedFrameRingReader(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        throw std::runtime_error(fmt::format("Couldn't open shared frame ring {}: {}", name, strerror(errno)));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SharedFrameRingHeader))
+    {
+        close(fd);
+        throw std::runtime_error(fmt::format("Shared frame ring {} is too small!", name));
+    }
+    size_ = st.st_size;
+
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error(fmt::format("Couldn't map shared frame ring {}: {}", name, strerror(errno)));
+    }
+    base_ = static_cast<const uint8_t*>(mapping);
+    header_ = reinterpret_cast<const SharedFrameRingHeader*>(base_);
+
+    bool valid = header_->magic == SHARED_FRAME_RING_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    valid = valid && header_->version == SHARED_FRAME_RING_VERSION &&
+            header_->headerSize + header_->slotStride * header_->slotCount <= size_;
+    if (!valid)
+    {
+        munmap(const_cast<uint8_t*>(base_), size_);
+        throw std::runtime_error(fmt::format("{} isn't a shared frame ring this version understands!", name));
+    }
+}
+
+SharedFrameRingReader::~SharedFrameRingReader()
+{
+    munmap(const_cast<uint8_t*>(base_), size_);
+}
+
+const SharedFrameRingHeader& SharedFrameRingReader::Header() const
+{
+    return *header_;
+}
+
+uint64_t SharedFrameRingReader::LatestFrame() const
+{
+    return header_->latestFrame.load(std::memory_order_acquire);
+}
+
+bool SharedFrameRingReader::Acquire(uint64_t frameNumber, FrameView& view) const
+{
+    if (frameNumber == 0)
+        return false;
+
+    const SharedFrameSlotHeader* slot = slotAt(const_cast<uint8_t*>(base_), *header_, frameNumber);
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1)
+        return false;
+
+    if (slot->frameNumber.load(std::memory_order_relaxed) != frameNumber)
+        return false;
+
+    view.pixels = reinterpret_cast<const uint8_t*>(slot) + sizeof(SharedFrameSlotHeader);
+    view.frameNumber = frameNumber;
+    view.timestampNs = slot->timestampNs.load(std::memory_order_relaxed);
+    view.sequence = sequence;
+    view.slot = slot;
+    return true;
+}
+
+bool SharedFrameRingReader::Validate(const FrameView& view) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+bool SharedFrameRingReader::Read(uint64_t frameNumber, uint8_t* pixels, int64_t& timestampNs) const
+{
+    for (int attempt=0; attempt < READ_ATTEMPTS; attempt++)
+    {
+        // The frame number and timestamp come from the same sequence check as the pixels
+        FrameView view;
+        if (!Acquire(frameNumber, view))
+            return false;
+
+        memcpy(pixels, view.pixels, header_->frameSize);
+        if (Validate(view))
+        {
+            timestampNs = view.timestampNs;
+            return true;
+        }
+    }
+    return false;
+}
@@ -1,10 +1,16 @@
 #include "SolarScene.hpp"
 #include "ConfigService.hpp"
+#include "FrameGovernor.hpp"
 static auto& config = ConfigService::global;
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
+// The sun crosses the display about once a day, so a few updates a second is
+// plenty in real time. Go faster when scene time is sped up.
+static const double REALTIME_REFRESH_HZ = 1.0;
+static const double FAST_TIME_REFRESH_HZ = 30.0;
+
 SolarScene::SolarScene(AstronomyService& astro) : Scene(SceneType::Base, SceneLifetime::Manual),
   _astro(astro)
 {   
@@ -30,6 +36,7 @@ SolarScene::SolarScene(AstronomyService& astro) : Scene(SceneType::Base, SceneLi
   _startJulianMoon = 0;
   _sunriseJulian = 0;
   _sunsetJulian = 0;
+  _curveQuality = 1.0f;
   
   _horizonLine.AddPoint({ 0, (float)_vOffset + 90.0f * (float)_vScale, 0,
                           {0.2f, 0.2f, 0.2f, 1.0f}});
@@ -89,8 +96,17 @@ static Color interpolate(Color start, Color end, float t)
 
 void SolarScene::updateOverride()
 {
-  // Generate today's solar curve if it's stale
+  // Generate today's solar curve if it's stale, or if the frame governor has
+  // changed how finely the curves should be sampled
   double nowJulian = TimeService::GetSceneTimeAsJulianDate();
+  float curveQuality = FrameGovernor::QualityScale();
+  if (curveQuality != _curveQuality)
+  {
+    _curveQuality = curveQuality;
+    _endJulian = 0;
+    _endJulianMoon = 0;
+  }
+  double curveStep = 4.0 / ((double)config.width() * _curveQuality);
   
   if (nowJulian > _endJulian || nowJulian < _startJulian)
   {
@@ -106,7 +122,7 @@ void SolarScene::updateOverride()
     std::vector<Vertex> points;
     double sunriseJulianGuess = 0;
     double sunsetJulianGuess = 0;
-    for (double t = _startJulian; t <= (_endJulian+0.05); t += (4.0/(double)config.width()))
+    for (double t = _startJulian; t <= (_endJulian+0.05); t += curveStep)
     {
       double latitudeDeg, longitudeDeg;
       _astro.GetSolarPoint(t, latitudeDeg, longitudeDeg);
@@ -176,7 +192,7 @@ void SolarScene::updateOverride()
     
     // Create the moon polyline
     std::vector<Vertex> points; 
-    for (double t = _startJulianMoon; t <= (_endJulianMoon+0.05); t += (4.0/(double)config.width()))
+    for (double t = _startJulianMoon; t <= (_endJulianMoon+0.05); t += curveStep)
     {
       double latitudeDeg, longitudeDeg;
       _astro.GetLunarPoint(t, latitudeDeg, longitudeDeg);
@@ -194,13 +210,19 @@ void SolarScene::updateOverride()
   }
   
   // Position the sun and moon
+  double nowJulianPrecise = TimeService::GetSceneTimeAsJulianDate();
   double sunLatDeg, sunlonDeg, moonLatDeg, moonlonDeg;
-  _astro.GetSolarPoint(TimeService::GetSceneTimeAsJulianDate(), sunLatDeg, sunlonDeg);
-  _astro.GetLunarPoint(TimeService::GetSceneTimeAsJulianDate(), moonLatDeg, moonlonDeg);
-  _sunCircle.SetLocation( (float) ( TimeService::GetSceneTimeAsJulianDate() -  _startJulian) * _hScale,
-                           (float) _vOffset + _astro.GetAngleDistInDegFromHomeTangent(sunLatDeg, sunlonDeg) * _vScale);    
-  _moonCircle.SetLocation( (float) ( TimeService::GetSceneTimeAsJulianDate() -  _startJulianMoon) * _hScale,
-                           (float) _vOffset + _astro.GetAngleDistInDegFromHomeTangent(moonLatDeg, moonlonDeg) * _vScale);
+  _astro.GetSolarPoint(nowJulianPrecise, sunLatDeg, sunlonDeg);
+  _astro.GetLunarPoint(nowJulianPrecise, moonLatDeg, moonlonDeg);
+
+  RenderState state;
+  state.sunX = (float) (nowJulianPrecise - _startJulian) * _hScale;
+  state.sunY = (float) _vOffset + _astro.GetAngleDistInDegFromHomeTangent(sunLatDeg, sunlonDeg) * _vScale;
+  state.moonX = (float) (nowJulianPrecise - _startJulianMoon) * _hScale;
+  state.moonY = (float) _vOffset + _astro.GetAngleDistInDegFromHomeTangent(moonLatDeg, moonlonDeg) * _vScale;
+  state.showMoon = _showMoon;
+  state.showSunrise = _sunriseJulian != 0;
+  state.showSunset = _sunsetJulian != 0;
                            
   // Style the sun and moon
   double sunAngle = _astro.GetAngleDistInDegFromHomeTangent(sunLatDeg, sunlonDeg);
@@ -234,24 +256,55 @@ void SolarScene::updateOverride()
                                80);
     _sunsetLabel.SetAlignment(HAlign::Center);
   }
+
+  bool fastTime = TimeService::GetSceneTimeMultiplier() > 1.0;
+  setRefreshRate(fastTime ? FAST_TIME_REFRESH_HZ : REALTIME_REFRESH_HZ);
+  _renderState.Publish(state, fastTime);
+}
+
+void SolarScene::releaseGLOverride()
+{
+  _solarLine.ReleaseGL();
+  _lunarLine.ReleaseGL();
+  _horizonLine.ReleaseGL();
+  _sunCircle.ReleaseGL();
+  _moonCircle.ReleaseGL();
+  _sunriseLabel.ReleaseGL();
+  _sunsetLabel.ReleaseGL();
 }
 
 void SolarScene::drawOverride()
 {
-  if (_sunriseJulian != 0) 
+  auto snapshot = _renderState.Latest();
+  if (!snapshot)
+    return;
+
+  const RenderState& state = snapshot->current;
+
+  if (state.showSunrise) 
     _sunriseLabel.Draw();
-  if (_sunsetJulian != 0) 
+  if (state.showSunset) 
   _sunsetLabel.Draw();
 
   _horizonLine.Draw();
-  if (_showMoon) 
+  if (state.showMoon) 
   {
     _lunarLine.Draw();
   }	
   _solarLine.Draw();
+
+  // Blend positions between the last two updates. Don't blend across a wrap 
+  // to the next day or the bodies would streak across the whole display.
+  const RenderState& prev = snapshot->previous;
+  float t = snapshot->Alpha(FrameClock::now());
+  if (t < 1.0f)
+    requestRedraw();
+  float sunX = fabs(state.sunX - prev.sunX) < _hScale / 2.0 ? interpolate(prev.sunX, state.sunX, t) : state.sunX;
+  float moonX = fabs(state.moonX - prev.moonX) < _hScale / 2.0 ? interpolate(prev.moonX, state.moonX, t) : state.moonX;
   
-  if (_showMoon) 
+  if (state.showMoon) 
   {
+    _moonCircle.SetLocation(moonX, interpolate(prev.moonY, state.moonY, t));
     _moonCircle.Draw();
     _moonCircle.Move(-config.width(), 0);
     _moonCircle.Draw();
@@ -259,6 +312,7 @@ void SolarScene::drawOverride()
     _moonCircle.Draw();
   }
   
+  _sunCircle.SetLocation(sunX, interpolate(prev.sunY, state.sunY, t));
   _sunCircle.Draw();
   _sunCircle.Move(-config.width(), 0);
   _sunCircle.Draw();
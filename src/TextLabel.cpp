@@ -38,6 +38,14 @@ TextLabel::~TextLabel()
 {
 }
 
+void TextLabel::ReleaseGL()
+{
+  _program.reset();
+  _fontTextureLarge.reset();
+  _fontTextureSmall.reset();
+  _fontTextureBigTall.reset();
+}
+
 void TextLabel::SetText(std::string text)
 {
   if (text != _text)
@@ -79,11 +87,13 @@ void TextLabel::SetAlignment(HAlign alignment)
 
 void TextLabel::SetColor(float r, float g, float b, float a)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _color = {r, g, b, a};
 }
 
 void TextLabel::SetPosition(float x, float y)
 {
+  std::lock_guard<std::mutex> lock(_mutex);
   _pos = {x, y};
 }
 
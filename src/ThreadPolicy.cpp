@@ -0,0 +1,277 @@
+#include "ThreadPolicy.hpp"
+#include "Utils.hpp"
+#include "ConfigService.hpp"
+static auto& config = ConfigService::global;
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <fmt/format.h>
+
+static const std::vector<std::string> THREAD_CLASSES = { "render", "update", "panel", "present", "convert", "http", "weather", "button", "output" };
+
+static const std::string DEFAULT_THREAD_POLICY = "other";
+static const int DEFAULT_THREAD_PRIORITY = 0;
+static const int DEFAULT_THREAD_NICE = 0;
+static const bool DEFAULT_LOCK_MEMORY = false;
+static const int DEFAULT_STACK_SIZE_KB = 0;
+
+struct ThreadClassSettings
+{
+    std::vector<int> cpus;
+    std::string policy = DEFAULT_THREAD_POLICY;
+    int priority = DEFAULT_THREAD_PRIORITY;
+    int nice = DEFAULT_THREAD_NICE;
+
+    bool IsDefault() const
+    {
+        return cpus.empty() && iequals(policy, DEFAULT_THREAD_POLICY) && nice == DEFAULT_THREAD_NICE;
+    }
+};
+
+struct ThreadClassReport
+{
+    std::vector<pid_t> threads;
+    std::vector<std::string> errors;
+};
+
+static std::mutex policyMutex;
+static bool initDone = false;
+static bool anyConfigured = false;
+static std::map<std::string, ThreadClassSettings> classSettings;
+static std::map<std::string, ThreadClassReport> classReports;
+static cpu_set_t processCpus;
+static int processNice = 0;
+static nlohmann::json memoryLockReport;
+
+void ThreadPolicy::Init()
+{
+    std::lock_guard<std::mutex> lock(policyMutex);
+
+    // What the process started with, for settings left at their defaults
+    CPU_ZERO(&processCpus);
+    sched_getaffinity(0, sizeof(processCpus), &processCpus);
+    errno = 0;
+    processNice = getpriority(PRIO_PROCESS, 0);
+    if (errno != 0)
+    {
+        processNice = 0;
+    }
+
+    for (const std::string& threadClass : THREAD_CLASSES)
+    {
+        ThreadClassSettings settings;
+        std::string prefix = "threads." + threadClass;
+        nlohmann::json cpus = config.GetConfigValue(prefix + ".cpus", nlohmann::json::array());
+        if (cpus.is_array())
+        {
+            for (const auto& cpu : cpus)
+            {
+                if (cpu.is_number_integer())
+                {
+                    settings.cpus.push_back(cpu.get<int>());
+                }
+            }
+        }
+        settings.policy = config.GetConfigValue(prefix + ".policy", DEFAULT_THREAD_POLICY);
+        settings.priority = config.GetConfigValue(prefix + ".priority", DEFAULT_THREAD_PRIORITY);
+        settings.nice = config.GetConfigValue(prefix + ".nice", DEFAULT_THREAD_NICE);
+        anyConfigured = anyConfigured || !settings.IsDefault();
+        classSettings[threadClass] = settings;
+    }
+
+    // Threads started after this (std::thread, httplib's workers) get the new default stack size
+    int stackSizeKB = config.GetConfigValue("threads.stackSizeKB", DEFAULT_STACK_SIZE_KB);
+    if (stackSizeKB > 0)
+    {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        int error = pthread_attr_setstacksize(&attr, (size_t)stackSizeKB * 1024);
+        if (error == 0)
+        {
+            error = pthread_setattr_default_np(&attr);
+        }
+        pthread_attr_destroy(&attr);
+        if (error != 0)
+        {
+            fprintf(stderr, "Couldn't set the thread stack size to %d KB: %s\n", stackSizeKB, strerror(error));
+            stackSizeKB = 0;
+        }
+    }
+
+    bool lockMemory = config.GetConfigValue("threads.lockMemory", DEFAULT_LOCK_MEMORY);
+    memoryLockReport = { {"requested", lockMemory}, {"locked", false}, {"stackSizeKB", stackSizeKB} };
+    if (lockMemory)
+    {
+        struct rlimit stackLimit;
+        if (stackSizeKB == 0 && getrlimit(RLIMIT_STACK, &stackLimit) == 0 && stackLimit.rlim_cur != RLIM_INFINITY)
+        {
+            fprintf(stderr, "Locking memory keeps all %llu KB of every thread's stack in RAM, set threads.stackSizeKB to use less.\n",
+                    (unsigned long long)stackLimit.rlim_cur / 1024);
+        }
+
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        {
+            memoryLockReport["locked"] = true;
+        }
+        else
+        {
+            memoryLockReport["error"] = strerror(errno);
+            fprintf(stderr, "Couldn't lock memory: %s\n", strerror(errno));
+        }
+    }
+
+    initDone = true;
+}
+
+void ThreadPolicy::Apply(const std::string& threadClass)
+{
+    ApplyToThread(threadClass, CurrentThread());
+}
+
+void ThreadPolicy::ApplyOnce(const std::string& threadClass)
+{
+    thread_local bool applied = false;
+    if (!applied)
+    {
+        applied = true;
+        Apply(threadClass);
+    }
+}
+
+void ThreadPolicy::ApplyToThread(const std::string& threadClass, pid_t tid)
+{
+    std::lock_guard<std::mutex> lock(policyMutex);
+    if (!initDone)
+        return;
+
+    auto it = classSettings.find(threadClass);
+    if (it == classSettings.end())
+    {
+        throw std::runtime_error(fmt::format("There's no thread class called {}!", threadClass));
+    }
+    const ThreadClassSettings& settings = it->second;
+    ThreadClassReport& report = classReports[threadClass];
+    report.threads.push_back(tid);
+
+    // The panel's refresh thread comes with the library's own real time settings,
+    // so it's only changed when asked to be
+    if (!anyConfigured || (threadClass == "panel" && settings.IsDefault()))
+        return;
+
+    auto fail = [&](const std::string& what)
+    {
+        std::string error = fmt::format("thread {}: {} ({})", tid, what, strerror(errno));
+        fprintf(stderr, "Couldn't set up %s thread policy, %s\n", threadClass.c_str(), error.c_str());
+        report.errors.push_back(error);
+    };
+
+    cpu_set_t cpus = processCpus;
+    if (!settings.cpus.empty())
+    {
+        CPU_ZERO(&cpus);
+        for (int cpu : settings.cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+    }
+    if (sched_setaffinity(tid, sizeof(cpus), &cpus) != 0)
+    {
+        fail("setting CPU affinity");
+    }
+
+    int policy = SCHED_OTHER;
+    if (iequals(settings.policy, "fifo"))
+    {
+        policy = SCHED_FIFO;
+    }
+    else if (iequals(settings.policy, "rr"))
+    {
+        policy = SCHED_RR;
+    }
+
+    struct sched_param param = {};
+    if (policy != SCHED_OTHER)
+    {
+        param.sched_priority = std::clamp(settings.priority, sched_get_priority_min(policy), sched_get_priority_max(policy));
+    }
+    if (sched_setscheduler(tid, policy, &param) != 0)
+    {
+        fail(fmt::format("setting the {} scheduler", settings.policy));
+    }
+
+    // Niceness is per thread on Linux, whatever PRIO_PROCESS says
+    int nice = settings.nice != DEFAULT_THREAD_NICE ? settings.nice : processNice;
+    if (policy == SCHED_OTHER && setpriority(PRIO_PROCESS, tid, std::clamp(nice, -20, 19)) != 0)
+    {
+        fail(fmt::format("setting nice {}", nice));
+    }
+}
+
+std::vector<pid_t> ThreadPolicy::ProcessThreads()
+{
+    std::vector<pid_t> threads;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc/self/task", error))
+    {
+        threads.push_back((pid_t)atoi(entry.path().filename().c_str()));
+    }
+    std::sort(threads.begin(), threads.end());
+    return threads;
+}
+
+pid_t ThreadPolicy::CurrentThread()
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+std::string ThreadPolicy::ThreadName(pid_t tid)
+{
+    std::ifstream comm(fmt::format("/proc/self/task/{}/comm", tid));
+    std::string name;
+    std::getline(comm, name);
+    return name;
+}
+
+void ThreadPolicy::SetThreadName(pid_t tid, const std::string& name)
+{
+    std::ofstream comm(fmt::format("/proc/self/task/{}/comm", tid));
+    comm << name.substr(0, 15);
+}
+
+nlohmann::json ThreadPolicy::Report()
+{
+    std::lock_guard<std::mutex> lock(policyMutex);
+
+    nlohmann::json report;
+    report["lockMemory"] = memoryLockReport;
+    report["applied"] = anyConfigured;
+    for (const std::string& threadClass : THREAD_CLASSES)
+    {
+        const ThreadClassSettings& settings = classSettings[threadClass];
+        const ThreadClassReport& applied = classReports[threadClass];
+
+        nlohmann::json entry;
+        entry["cpus"] = settings.cpus;
+        entry["policy"] = settings.policy;
+        entry["priority"] = settings.priority;
+        entry["nice"] = settings.nice;
+        entry["threads"] = applied.threads;
+        entry["errors"] = applied.errors;
+        report["classes"][threadClass] = entry;
+    }
+    return report;
+}
@@ -1,4 +1,5 @@
 #include "TimeService.hpp"
+#include "FramePacer.hpp"
 
 struct Impl
 {
@@ -8,6 +9,9 @@ struct Impl
     double timeMultiplier;
     bool timePaused;
 
+    // Render loop frame pacing
+    FramePacer framePacer;
+
     Impl()
     {
         // Internal vars
@@ -184,20 +188,44 @@ std::tm TimeService::GetLocaltimeFromJulianDate(double julian)
 // (Generally 1/60 but can be configured)
 double TimeService::GetTargetFrameDelta()
 {
-    return 0;
+    return std::chrono::duration_cast<fractionalSeconds>(impl.framePacer.GetTargetFrameDelta()).count();
 }
 
 // Get the actual time, in seconds, that it took to render the last frame
 double TimeService::GetLastFrameDelta()
 {
-    return 0;
+    return std::chrono::duration_cast<fractionalSeconds>(impl.framePacer.GetLastFrameDelta()).count();
 }
 
 // Record now as when the current frame finished rendering.
 // If (thisTp - lastTp) < TargetFrameDelta, wait until lastTp + TargetFrameDelta
 void TimeService::FinishAndWaitForNextFrame()
 {
-    
+    impl.framePacer.FinishAndWaitForNextFrame();
+}
+
+// Set the target frame rate for FinishAndWaitForNextFrame
+void TimeService::SetTargetFrameRate(double fps)
+{
+    impl.framePacer.SetTargetFrameRate(fps);
+}
+
+// Choose whether overrunning frames are skipped or caught up
+void TimeService::SetFrameOverrunPolicy(FrameOverrunPolicy policy)
+{
+    impl.framePacer.SetOverrunPolicy(policy);
+}
+
+// How long before a frame deadline to switch from sleeping to spinning
+void TimeService::SetFrameSpinThreshold(FrameDuration threshold)
+{
+    impl.framePacer.SetSpinThreshold(threshold);
+}
+
+// Restart frame pacing, e.g. when the render loop resumes after sleeping
+void TimeService::ResetFrameTiming()
+{
+    impl.framePacer.Reset();
 }
 
 
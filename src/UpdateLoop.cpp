@@ -0,0 +1,187 @@
+#include "UpdateLoop.hpp"
+#include "ThreadPolicy.hpp"
+
+#include <algorithm>
+
+static const double DEFAULT_TICK_RATE = 60.0;
+
+// Longest the update thread sleeps without checking in, even if no scene is due
+static const FrameDuration MAX_IDLE_WAIT = std::chrono::seconds(1);
+
+UpdateLoop::UpdateLoop(const std::vector<Scene*>& baseScenes, const std::vector<Scene*>& overlayScenes) :
+    baseScenes_(baseScenes),
+    overlayScenes_(overlayScenes),
+    paused_(false),
+    stopRequested_(false),
+    wakeRequested_(false),
+    wakeSignal_(nullptr),
+    tickRate_(DEFAULT_TICK_RATE)
+{
+    pacer_.SetTargetFrameRate(DEFAULT_TICK_RATE);
+}
+
+UpdateLoop::~UpdateLoop()
+{
+    Stop();
+}
+
+void UpdateLoop::Start()
+{
+    if (thread_ != nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopRequested_ = false;
+    }
+
+    thread_ = std::make_unique<std::thread>([this]()
+    {
+        ThreadPolicy::Apply("update");
+        run();
+    });
+}
+
+void UpdateLoop::Stop()
+{
+    if (thread_ == nullptr)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        stopRequested_ = true;
+    }
+    stateChanged_.notify_all();
+
+    thread_->join();
+    thread_ = nullptr;
+}
+
+void UpdateLoop::SetTickRate(double hz)
+{
+    tickRate_ = hz > 0.0 ? hz : DEFAULT_TICK_RATE;
+}
+
+void UpdateLoop::SetPaused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        if (paused_ == paused)
+            return;
+        paused_ = paused;
+    }
+    stateChanged_.notify_all();
+}
+
+std::unique_lock<std::mutex> UpdateLoop::LockScenes()
+{
+    return std::unique_lock<std::mutex>(sceneMutex_);
+}
+
+FrameTimePoint UpdateLoop::Tick()
+{
+    std::lock_guard<std::mutex> lock(sceneMutex_);
+
+    FrameTimePoint now = FrameClock::now();
+    FrameTimePoint nextDue = now + MAX_IDLE_WAIT;
+    bool anyUpdated = false;
+
+    // Scenes due within half a tick count as due now, otherwise a scene that
+    // wants the full tick rate would miss every other tick from timing jitter
+    FrameTimePoint dueBy = now + pacer_.GetTargetFrameDelta() / 2;
+
+    auto tickScenes = [&](const std::vector<Scene*>& scenes)
+    {
+        for (Scene *scene : scenes)
+        {
+            if (!scene->Visible())
+                continue;
+
+            if (scene->NextUpdateTime() <= dueBy)
+            {
+                scene->Update();
+                anyUpdated = true;
+            }
+
+            // The update may have hidden the scene
+            if (scene->Visible())
+            {
+                nextDue = std::min(nextDue, scene->NextUpdateTime());
+            }
+        }
+    };
+
+    tickScenes(baseScenes_);
+    tickScenes(overlayScenes_);
+
+    WakeSignal* wakeSignal = wakeSignal_;
+    if (anyUpdated && wakeSignal != nullptr)
+    {
+        wakeSignal->Notify();
+    }
+
+    return nextDue;
+}
+
+void UpdateLoop::WakeAll()
+{
+    for (Scene *scene : baseScenes_)
+    {
+        scene->Wake();
+    }
+
+    for (Scene *scene : overlayScenes_)
+    {
+        scene->Wake();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(stateMutex_);
+        wakeRequested_ = true;
+    }
+    stateChanged_.notify_all();
+}
+
+void UpdateLoop::SetWakeSignal(WakeSignal* wakeSignal)
+{
+    wakeSignal_ = wakeSignal;
+}
+
+void UpdateLoop::run()
+{
+    double currentRate = 0.0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex_);
+            if (paused_)
+            {
+                stateChanged_.wait(lock, [&]() { return !paused_ || stopRequested_; });
+
+                // Don't try to make up for the ticks we missed while paused
+                pacer_.Reset();
+            }
+            if (stopRequested_)
+                break;
+        }
+
+        // Pick up tick rate changes here so the pacer is only touched by this thread
+        if (tickRate_ != currentRate)
+        {
+            currentRate = tickRate_;
+            pacer_.SetTargetFrameRate(currentRate);
+        }
+
+        FrameTimePoint nextDue = Tick();
+
+        // The pacer caps the tick rate, then we sleep until a scene is actually due
+        pacer_.FinishAndWaitForNextFrame();
+        
+        {
+            std::unique_lock<std::mutex> lock(stateMutex_);
+            stateChanged_.wait_until(lock, nextDue, [&]() { return wakeRequested_ || paused_ || stopRequested_; });
+            wakeRequested_ = false;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#include "WakeSignal.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+WakeSignal::WakeSignal()
+{
+#ifdef __linux__
+    readFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    writeFd_ = readFd_;
+    if (readFd_ == -1)
+    {
+        throw std::runtime_error("Couldn't create eventfd for wake signal!");
+    }
+#else
+    int fds[2];
+    if (pipe(fds) == -1)
+    {
+        throw std::runtime_error("Couldn't create pipe for wake signal!");
+    }
+    readFd_ = fds[0];
+    writeFd_ = fds[1];
+    for (int fd : fds)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#endif
+}
+
+WakeSignal::~WakeSignal()
+{
+    close(readFd_);
+    if (writeFd_ != readFd_)
+    {
+        close(writeFd_);
+    }
+}
+
+void WakeSignal::Notify()
+{
+    // Only async-signal-safe calls in here. If the write would block,
+    // there's already a wake pending so there's nothing to do.
+    int savedErrno = errno;
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t result = write(writeFd_, &one, sizeof(one));
+#else
+    uint8_t one = 1;
+    ssize_t result = write(writeFd_, &one, sizeof(one));
+#endif
+    (void)result;
+    errno = savedErrno;
+}
+
+void WakeSignal::Wait()
+{
+    wait(-1);
+}
+
+bool WakeSignal::WaitFor(FrameDuration timeout)
+{
+    // Round up so short timeouts don't turn into a busy loop
+    auto timeoutMs = std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+    return wait(timeoutMs > 0 ? (int)timeoutMs : 0);
+}
+
+bool WakeSignal::wait(int timeoutMs)
+{
+    pollfd pfd { readFd_, POLLIN, 0 };
+    int result = poll(&pfd, 1, timeoutMs);
+
+    // Being interrupted by a signal counts as a wake, the caller will want to check why
+    if (result < 0)
+    {
+        return errno == EINTR;
+    }
+    if (result == 0)
+    {
+        return false;
+    }
+
+    drain();
+    return true;
+}
+
+void WakeSignal::drain()
+{
+#ifdef __linux__
+    // Reading an eventfd resets its counter
+    uint64_t count;
+    ssize_t result = read(readFd_, &count, sizeof(count));
+    (void)result;
+#else
+    uint8_t buffer[64];
+    while (read(readFd_, buffer, sizeof(buffer)) > 0)
+    {
+    }
+#endif
+}
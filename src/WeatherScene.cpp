@@ -1,6 +1,7 @@
 #include "WeatherScene.hpp"
 #include "AstronomyService.hpp"
 #include "ConfigService.hpp"
+#include "ThreadPolicy.hpp"
 static auto& config = ConfigService::global;
 
 #include <httplib.h>
@@ -49,11 +50,16 @@ WeatherScene::WeatherScene() : Scene(SceneType::Overlay, SceneLifetime::Manual)
   // Add child elements...
   Elements.push_back(&_tempLabel);
 
+  // The temperature is only fetched once a minute, just poll for it now and then
+  setRefreshRate(0.2);
+
   _noaaTemp = "Initializing";
   _exitTempUpdateThread = false;
   
   _tempUpdateThread = std::make_shared<std::thread>([&]()
   { 
+    ThreadPolicy::Apply("weather");
+
     // Create a client to noaa's API
     httplib::Client noaa("https://api.weather.gov");
     noaa.set_default_headers({
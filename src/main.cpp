@@ -18,15 +18,28 @@ static auto& config = ConfigService::global;
 #include "DisplayDevice.hpp"
 #include "InputButton.hpp"
 #include "PhysicsScene.hpp"
+#include "UpdateLoop.hpp"
+#include "WakeSignal.hpp"
+#include "Benchmark.hpp"
+#include "FrameRecording.hpp"
+#include "PreviewService.hpp"
+#include "ThreadPolicy.hpp"
+#include "FrameGovernor.hpp"
+#include "MetricsService.hpp"
+#include "NetFrameStream.hpp"
+#include "SharedFrameRing.hpp"
 
 #include <unistd.h>
 #include <signal.h>
 #include <thread>
+#include <atomic>
 #include <algorithm>
 #include <map>
+#include <random>
 #include <string>
 #include <vector>
 #include <iostream>
+#include <cstdlib>
 
 #include <nlohmann/json.hpp>
 #include <fmt/format.h>
@@ -36,11 +49,31 @@ using json = nlohmann::json;
 
 static const std::string DEFAULT_SCENE_NAME = "Solar";
 static const int DEFAULT_FPS = 60;
+static const std::string DEFAULT_FRAME_OVERRUN_POLICY = "skip";
+static const int DEFAULT_FRAME_SPIN_MICROSECONDS = 500;
+static const int DEFAULT_UPDATE_RATE = 60;
+static const bool DEFAULT_DEEP_SLEEP = false;
+static const int DEFAULT_DEEP_SLEEP_DELAY_SECONDS = 300;
+static const bool DEFAULT_DEEP_SLEEP_RELEASE_CONTEXT = false;
+static const int DEFAULT_BENCH_FRAMES = 300;
+static const std::string DEFAULT_DISPLAY_BACKEND = "auto";
+static const int DEFAULT_NET_CLIENT_TIMEOUT_SECONDS = 5;
+
+// How often to pump display events while idle, for displays whose events can't wake us
+static const auto EVENT_POLL_INTERVAL = std::chrono::milliseconds(50);
+static const auto SELF_TEST_DURATION = std::chrono::seconds(2);
+static const int NET_SELF_TEST_FRAMES = 200;
+static const int NET_SELF_TEST_KEYFRAME_INTERVAL = 30;
 
 volatile bool interrupt_received = false;
 volatile bool internal_exit = false;
 static bool sleeping = false;
-static auto expectedFrameTime = std::chrono::high_resolution_clock::duration::min();
+
+// Set when a frame bus subscriber needs a frame the scenes wouldn't otherwise draw
+static std::atomic<bool> frameRequested(false);
+
+// Everything that needs the main thread's attention notifies this
+static WakeSignal* mainThreadWake = nullptr;
 
 static std::vector<Scene*> baseScenes;
 static std::vector<Scene*> overlayScenes;
@@ -50,6 +83,10 @@ static sigslot::signal<std::string> sceneChanged;
 static void InterruptHandler(int signo)
 {
     interrupt_received = true;
+    if (mainThreadWake != nullptr)
+    {
+        mainThreadWake->Notify();
+    }
 }
 
 static Scene* getSceneByName(std::string sceneName)
@@ -160,107 +197,389 @@ static void addScene(Scene* scene, HttpService& http)
     scene->RegisterEndpoints(http);
 }
 
-static void addButton(InputButton& b)
+static void addButton(InputButton& b, CommandQueue& commands)
 {
-    b.OnTap.connect([&]()
+    // Buttons fire from their own threads, so queue their actions for the main thread
+    b.OnTap.connect([&commands]()
     {
-        // If we are asleep, wake
-        if (sleeping)
-        {
-            reset();
-        }
-        // If we are awake, go to next scene
-        else
+        commands.Post([]()
         {
-            // If this is the last scene, sleep
-            if (!showNext())
+            // If we are asleep, wake
+            if (sleeping)
             {
-                sleeping = true;
+                reset();
             }
-        }
+            // If we are awake, go to next scene
+            else
+            {
+                // If this is the last scene, sleep
+                if (!showNext())
+                {
+                    sleeping = true;
+                }
+            }
+        });
     });
 
-    b.OnHold.connect([&]()
+    b.OnHold.connect([&commands]()
     {
-        // Go to sleep
-        sleeping = true;
+        commands.Post([]()
+        {
+            // Go to sleep
+            sleeping = true;
+        });
     });
 }
 
-void setupSystemHttpEndpoints(httplib::Server& srv)
+void setupSystemHttpEndpoints(HttpService& http)
 {
-    srv.Post("/system/sleep", [=](const httplib::Request& req, httplib::Response& res) 
+    httplib::Server& srv = http.Server();
+
+    srv.Post("/system/sleep", [&http](const httplib::Request& req, httplib::Response& res) 
     {
-        sleep();
+        http.RunOnMainThread([]()
+        {
+            sleep();
+            return HttpResult();
+        }, res);
     });
 
-    srv.Post("/system/reset", [=](const httplib::Request& req, httplib::Response& res) 
+    srv.Post("/system/reset", [&http](const httplib::Request& req, httplib::Response& res) 
     {
-        reset();
+        http.RunOnMainThread([]()
+        {
+            reset();
+            return HttpResult();
+        }, res);
     });
 
-    srv.Post("/system/restart", [=](const httplib::Request& req, httplib::Response& res) 
+    srv.Post("/system/restart", [&http](const httplib::Request& req, httplib::Response& res) 
     {
-        internal_exit = true;
+        // Posting wakes the main loop so it notices right away
+        http.Commands().Post([]()
+        {
+            internal_exit = true;
+        });
     });
 
-    srv.Patch("/system/settings", [=](const httplib::Request& req, httplib::Response& res) 
+    srv.Patch("/system/settings", [&http](const httplib::Request& req, httplib::Response& res) 
     {
         auto settingsPatch = json::parse(req.body);
 
-        for (auto& kvp : settingsPatch.items())
+        http.RunOnMainThread([settingsPatch]()
         {
-            if (!config.HasKey(kvp.key()))
+            for (auto& kvp : settingsPatch.items())
             {
-                res.status = 400;
-                res.body = fmt::format("Bad patch request, settings key {} is invalid.", kvp.key());
-                return;
+                if (!config.HasKey(kvp.key()))
+                {
+                    return HttpResult { 400, fmt::format("Bad patch request, settings key {} is invalid.", kvp.key()) };
+                }
+
+                if (!config.ValueTypeMatches(kvp.key(), kvp.value()))
+                {
+                    return HttpResult { 400, fmt::format("Bad patch request, value {} was an incorrect type.", kvp.key()) };
+                }
             }
 
-            if (!config.ValueTypeMatches(kvp.key(), kvp.value()))
+            for (auto& kvp : settingsPatch.items())
             {
-                res.status = 400;
-                res.body = fmt::format("Bad patch request, value {} was an incorrect type.", kvp.key());
-                return;
+                config.SetConfigValue(kvp.key(), kvp.value());
             }
-        }
+            return HttpResult();
+        }, res);
+    });
 
-        for (auto& kvp : settingsPatch.items())
+    srv.Get("/system/settings", [&http](const httplib::Request& req, httplib::Response& res) 
+    {
+        http.RunOnMainThread([]()
         {
-            config.SetConfigValue(kvp.key(), kvp.value());
-        }
+            std::stringstream ss;
+            ss << std::setw(4) << config.GetConfigJson();
+            return HttpResult { 200, ss.str() };
+        }, res);
     });
 
-    srv.Get("/system/settings", [=](const httplib::Request& req, httplib::Response& res) 
+    srv.Get("/system/threads", [](const httplib::Request& req, httplib::Response& res) 
     {
         std::stringstream ss;
-        ss << std::setw(4) << config.GetConfigJson();
-        res.body = ss.str();
+        ss << std::setw(4) << ThreadPolicy::Report();
+        res.set_content(ss.str(), "application/json");
     });
 
-    srv.Get("/scenes", [=](const httplib::Request& req, httplib::Response& res) 
+    srv.Get("/system/governor", [](const httplib::Request& req, httplib::Response& res) 
     {
-        json scenes = json::array();
-        for (const auto& scene : baseScenes)
-        {
-            scenes.push_back(scene->SceneName());
-        }
         std::stringstream ss;
-        ss << std::setw(4) << scenes;
-        res.body = ss.str();
+        ss << std::setw(4) << FrameGovernor::Report();
+        res.set_content(ss.str(), "application/json");
+    });
+
+    srv.Get("/scenes", [&http](const httplib::Request& req, httplib::Response& res) 
+    {
+        http.RunOnMainThread([]()
+        {
+            json scenes = json::array();
+            for (const auto& scene : baseScenes)
+            {
+                scenes.push_back(scene->SceneName());
+            }
+            std::stringstream ss;
+            ss << std::setw(4) << scenes;
+            return HttpResult { 200, ss.str() };
+        }, res);
     });
 
-    srv.Post(R"(/scenes/([a-zA-Z0-9]+)/show)", [=](const httplib::Request& req, httplib::Response& res) 
+    srv.Post(R"(/scenes/([a-zA-Z0-9]+)/show)", [&http](const httplib::Request& req, httplib::Response& res) 
     {
-        auto scene = getSceneByName(req.matches[1].str());
-        if (scene == nullptr)
+        std::string sceneName = req.matches[1].str();
+        http.RunOnMainThread([sceneName]()
         {
-            res.status = 404;
-            res.body = fmt::format("The scene {} was not found.", req.matches[1].str());
-            return;
+            auto scene = getSceneByName(sceneName);
+            if (scene == nullptr)
+            {
+                return HttpResult { 404, fmt::format("The scene {} was not found.", sceneName) };
+            }
+            showScene(scene->SceneName());
+            return HttpResult();
+        }, res);
+    });
+}
+
+// Play a recording made with the "record" display back into a display, without
+// running any scenes. Frames keep their recorded spacing unless maxSpeed is set.
+// Prints how it went as JSON and returns the process exit code.
+static int replayRecording(const std::string& path, bool maxSpeed, const std::string& displayBackend)
+{
+    FrameReplayer replayer(path);
+    if (replayer.Width() != config.width() || replayer.Height() != config.height())
+    {
+        fprintf(stderr, "%s is %dx%d but the display is configured for %dx%d.\n", 
+                path.c_str(), replayer.Width(), replayer.Height(), config.width(), config.height());
+        return 1;
+    }
+
+    DisplayDevice display(displayBackend);
+    display.OnDisconnect.connect([](){internal_exit = true;});
+    ThreadPolicy::Apply("render");
+
+    ImageRGBA frame(replayer.Width(), replayer.Height());
+    int64_t timestampNs;
+    uint64_t frames = 0;
+    auto start = FrameClock::now();
+    while (!interrupt_received && !internal_exit && replayer.Next(frame, timestampNs))
+    {
+        if (!maxSpeed)
+        {
+            // Keep the display's events flowing through long gaps between frames
+            auto due = start + std::chrono::nanoseconds(timestampNs);
+            while (!interrupt_received && !internal_exit && FrameClock::now() < due)
+            {
+                std::this_thread::sleep_until(std::min(due, FrameClock::now() + EVENT_POLL_INTERVAL));
+                display.ProcessEvents();
+            }
+        }
+
+        display.Update(frame);
+        frames++;
+    }
+    double seconds = std::chrono::duration<double>(FrameClock::now() - start).count();
+
+    json result;
+    result["file"] = path;
+    result["display"] = display.GetBackendName();
+    result["speed"] = maxSpeed ? "max" : "original";
+    result["frames"] = frames;
+    result["seconds"] = seconds;
+    result["fps"] = seconds > 0 ? frames / seconds : 0.0;
+    std::cout << std::setw(4) << result << std::endl;
+    return 0;
+}
+
+// Show frames streamed by another instance's "net" display, without running any
+// scenes or the renderer. The display is blanked if the stream stops for a while.
+// Prints how it went as JSON and returns the process exit code.
+static int runNetClient(int port, const std::string& displayBackend)
+{
+    int timeoutSeconds = config.GetConfigValue("netClient.timeoutSeconds", DEFAULT_NET_CLIENT_TIMEOUT_SECONDS);
+
+    DisplayDevice display(displayBackend);
+    display.OnDisconnect.connect([](){internal_exit = true;});
+    ThreadPolicy::Apply("render");
+
+    NetFrameReceiver receiver(port, config.width(), config.height());
+    fprintf(stderr, "Waiting for %dx%d frames on port %d.\n", config.width(), config.height(), port);
+
+    ImageRGBA frame(config.width(), config.height());
+    FrameTimePoint lastFrameTime = FrameClock::now();
+    bool blank = true;
+    while (!interrupt_received && !internal_exit)
+    {
+        if (receiver.Receive(frame, EVENT_POLL_INTERVAL))
+        {
+            display.Update(frame);
+            lastFrameTime = FrameClock::now();
+            blank = false;
+        }
+        else
+        {
+            // Keep the display's events flowing while nothing's coming in
+            display.ProcessEvents();
+            if (!blank && FrameClock::now() - lastFrameTime > std::chrono::seconds(timeoutSeconds))
+            {
+                display.Clear();
+                blank = true;
+            }
+        }
+    }
+
+    json result;
+    result["port"] = port;
+    result["display"] = display.GetBackendName();
+    result["framesReceived"] = receiver.FramesReceived();
+    result["framesLost"] = receiver.FramesLost();
+    std::cout << std::setw(4) << result << std::endl;
+    return 0;
+}
+
+// Check that readers of the shared frame ring only ever see whole frames. A writer
+// thread publishes frames as fast as it can into a two slot ring, each filled with a
+// byte worked out from its frame number, while this thread reads frames back and
+// checks every byte. Prints the counts as JSON; fails if any frame came back torn.
+static int runSharedFrameRingSelfTest()
+{
+    auto fillByte = [](uint64_t frameNumber) { return (uint8_t)(frameNumber * 31 + 7); };
+
+    std::string name = fmt::format("/mantlemap-selftest-{}", getpid());
+    SharedFrameRingWriter writer(name, config.width(), config.height(), SharedFrameFormat::RGBA8, 2);
+    SharedFrameRingReader reader(name);
+    size_t frameSize = reader.Header().frameSize;
+
+    std::atomic<bool> stop(false);
+    std::thread writerThread([&]()
+    {
+        for (uint64_t frameNumber = 1; !stop; frameNumber++)
+        {
+            memset(writer.BeginWrite(), fillByte(frameNumber), frameSize);
+            writer.EndWrite();
         }
-        showScene(scene->SceneName());
     });
+
+    std::vector<uint8_t> pixels(frameSize);
+    uint64_t framesRead = 0;
+    uint64_t framesMissed = 0;
+    uint64_t framesTorn = 0;
+    uint64_t lastFrame = 0;
+    uint64_t attempts = 0;
+    FrameTimePoint end = FrameClock::now() + SELF_TEST_DURATION;
+    while (FrameClock::now() < end)
+    {
+        // Alternate between the newest frame and the one before it, whose slot is the
+        // one being overwritten, so reads race with the writer as often as possible
+        uint64_t latest = reader.LatestFrame();
+        uint64_t frameNumber = (attempts++ % 2 == 0) ? latest : latest - 1;
+        if (latest < 2 || frameNumber == lastFrame)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        lastFrame = frameNumber;
+
+        int64_t timestampNs;
+        if (!reader.Read(frameNumber, pixels.data(), timestampNs))
+        {
+            framesMissed++;
+            continue;
+        }
+        framesRead++;
+
+        uint8_t expected = fillByte(frameNumber);
+        if (std::any_of(pixels.begin(), pixels.end(), [&](uint8_t b) { return b != expected; }))
+        {
+            framesTorn++;
+        }
+    }
+    stop = true;
+    writerThread.join();
+
+    json result;
+    result["framesRead"] = framesRead;
+    result["framesMissed"] = framesMissed;
+    result["framesTorn"] = framesTorn;
+    result["passed"] = framesRead > 0 && framesTorn == 0;
+    std::cout << std::setw(4) << result << std::endl;
+    return result["passed"].get<bool>() ? 0 : 1;
+}
+
+// Check the net display's stream over loopback. Frames with a few random rows changed
+// each time are sent as a tile from the middle of the frame, and the receiver must put
+// every one back together exactly. Then a second receiver joins after the last change,
+// when only the sender's repeated keyframes can catch it up. Prints the counts as JSON.
+static int runNetSelfTest(int port)
+{
+    NetFrameTile tile;
+    tile.address = "127.0.0.1";
+    tile.port = port;
+    tile.x = config.width() / 4;
+    tile.y = config.height() / 4;
+    tile.width = std::max(config.width() / 2, 1);
+    tile.height = std::max(config.height() / 2, 1);
+    NetFrameSender sender(tile, NET_SELF_TEST_KEYFRAME_INTERVAL);
+
+    ImageRGBA frame(config.width(), config.height());
+    ImageRGBA received(tile.width, tile.height);
+    auto matches = [&]()
+    {
+        for (int y=0; y < tile.height; y++)
+        {
+            const uint8_t* sent = frame.data() + ((tile.y + y) * frame.width() + tile.x) * 4;
+            if (memcmp(sent, received.data() + y * tile.width * 4, tile.width * 4) != 0)
+                return false;
+        }
+        return true;
+    };
+
+    std::mt19937 random(1234);
+    uint64_t framesMatched = 0;
+    uint64_t framesWrong = 0;
+    uint64_t framesMissed = 0;
+    {
+        NetFrameReceiver receiver(port, tile.width, tile.height);
+        for (int i=0; i < NET_SELF_TEST_FRAMES; i++)
+        {
+            for (int rows=0; rows < 4; rows++)
+            {
+                uint8_t* row = frame.data() + (tile.y + random() % tile.height) * frame.width() * 4;
+                std::generate(row, row + frame.width() * 4, [&]() { return (uint8_t)random(); });
+            }
+
+            sender.Send(frame);
+            if (!receiver.Receive(received, std::chrono::seconds(1)))
+            {
+                framesMissed++;
+                continue;
+            }
+            (matches() ? framesMatched : framesWrong)++;
+        }
+    }
+
+    // Nothing has changed since, so only a repeated keyframe can catch this one up
+    NetFrameReceiver lateReceiver(port, tile.width, tile.height);
+    bool lateJoinerCaughtUp = false;
+    FrameTimePoint end = FrameClock::now() + SELF_TEST_DURATION;
+    while (!lateJoinerCaughtUp && FrameClock::now() < end)
+    {
+        sender.SendKeyframeIfDue();
+        lateJoinerCaughtUp = lateReceiver.Receive(received, std::chrono::milliseconds(100)) && matches();
+    }
+
+    json result;
+    result["port"] = port;
+    result["framesMatched"] = framesMatched;
+    result["framesWrong"] = framesWrong;
+    result["framesMissed"] = framesMissed;
+    result["lateJoinerCaughtUp"] = lateJoinerCaughtUp;
+    result["passed"] = framesMatched == NET_SELF_TEST_FRAMES && lateJoinerCaughtUp;
+    std::cout << std::setw(4) << result << std::endl;
+    return result["passed"].get<bool>() ? 0 : 1;
 }
 
 int main(int argc, char *argv[])
@@ -273,8 +592,103 @@ int main(int argc, char *argv[])
     // and because lots of components rely on its basic vars being set
     config.Init();
 
+    // Thread settings have to be known before any threads start
+    ThreadPolicy::Init();
+    FrameGovernor::Init();
+
+    // --bench [frames] draws every scene headless and prints timings instead of running normally
+    // --display <backend> overrides the displayBackend setting for this run
+    // --replay <file> [--replay-speed original|max] plays a recording into the display and exits
+    // --net-client [port] shows frames streamed from another instance's net display
+    // --shm-selftest checks the shared frame ring's readers never see torn frames
+    // --net-selftest [port] streams frames to itself over loopback and checks what arrives
+    bool benchMode = false;
+    int benchFrames = DEFAULT_BENCH_FRAMES;
+    std::string replayPath;
+    bool replayMaxSpeed = false;
+    bool netClient = false;
+    bool shmSelfTest = false;
+    bool netSelfTest = false;
+    int netClientPort = config.GetConfigValue("netClient.port", DEFAULT_NET_FRAME_PORT);
+    std::string displayBackend = config.GetConfigValue("displayBackend", DEFAULT_DISPLAY_BACKEND);
+    for (int i=1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--bench")
+        {
+            benchMode = true;
+            if (i+1 < argc && isdigit(argv[i+1][0]))
+            {
+                benchFrames = std::max(1, atoi(argv[++i]));
+            }
+        }
+        else if (std::string(argv[i]) == "--display" && i+1 < argc)
+        {
+            displayBackend = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--replay" && i+1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (std::string(argv[i]) == "--replay-speed" && i+1 < argc)
+        {
+            replayMaxSpeed = iequals(argv[++i], "max");
+        }
+        else if (std::string(argv[i]) == "--net-client")
+        {
+            netClient = true;
+            if (i+1 < argc && isdigit(argv[i+1][0]))
+            {
+                netClientPort = atoi(argv[++i]);
+            }
+        }
+        else if (std::string(argv[i]) == "--shm-selftest")
+        {
+            shmSelfTest = true;
+        }
+        else if (std::string(argv[i]) == "--net-selftest")
+        {
+            netSelfTest = true;
+            if (i+1 < argc && isdigit(argv[i+1][0]))
+            {
+                netClientPort = atoi(argv[++i]);
+            }
+        }
+    }
+
+    if (shmSelfTest)
+    {
+        return runSharedFrameRingSelfTest();
+    }
+
+    if (netSelfTest)
+    {
+        return runNetSelfTest(netClientPort);
+    }
+
+    // Replay and net clients don't need scenes, the web server or the renderer
+    if (!replayPath.empty())
+    {
+        return replayRecording(replayPath, replayMaxSpeed, displayBackend);
+    }
+
+    if (netClient)
+    {
+        return runNetClient(netClientPort, displayBackend);
+    }
+
+    // Don't fight a running instance for its port. This is never saved.
+    if (benchMode)
+    {
+        config.SetConfigValue("httpServicePort", 0);
+    }
+
+    WakeSignal mainWake;
+    mainThreadWake = &mainWake;
+
     std::string defaultScene = DEFAULT_SCENE_NAME;
     int fpsLimit = DEFAULT_FPS;
+    std::string frameOverrunPolicy = DEFAULT_FRAME_OVERRUN_POLICY;
+    int frameSpinMicroseconds = DEFAULT_FRAME_SPIN_MICROSECONDS;
     
     // Subscribe to settings changes (this also runs the lambda once before subscribing)
     config.Subscribe([&](const ConfigUpdateEventArg& arg)
@@ -283,14 +697,26 @@ int main(int argc, char *argv[])
         
         if (arg.UpdateIfChanged("fpsLimit", fpsLimit, DEFAULT_FPS))
         {
-            expectedFrameTime = std::chrono::high_resolution_clock::duration(
-            std::chrono::nanoseconds((int)(1.0/(double)fpsLimit * 1000000000.0))    );
+            FrameGovernor::SetFrameRate(fpsLimit);
+        }
+
+        if (arg.UpdateIfChanged("frameOverrunPolicy", frameOverrunPolicy, DEFAULT_FRAME_OVERRUN_POLICY))
+        {
+            TimeService::SetFrameOverrunPolicy(iequals(frameOverrunPolicy, "catchup") ? 
+                                                FrameOverrunPolicy::CatchUp : 
+                                                FrameOverrunPolicy::Skip);
+        }
+
+        if (arg.UpdateIfChanged("frameSpinMicroseconds", frameSpinMicroseconds, DEFAULT_FRAME_SPIN_MICROSECONDS))
+        {
+            TimeService::SetFrameSpinThreshold(std::chrono::microseconds(frameSpinMicroseconds));
         }
     });
 
     // Add the HTTP service to serve web requests
     HttpService httpService;
-    setupSystemHttpEndpoints(httpService.Server());
+    httpService.Commands().SetWakeSignal(&mainWake);
+    setupSystemHttpEndpoints(httpService);
 
     // Init the astro / NOVAS lib
     AstronomyService astronomyService;
@@ -332,73 +758,253 @@ int main(int argc, char *argv[])
     // Bring up the first base scene
     showScene(0);
 
-    // Save the config after opening all the scenes
-    config.SaveConfig();
-
     // Create our hardware accelerated renderer
     GLRenderContext render;
 
+    if (benchMode)
+    {
+        // No real display, update thread or config changes in bench mode
+        DisplayDevice nullDisplay("null");
+        Benchmark bench(baseScenes, overlayScenes, render, nullDisplay);
+        std::cout << std::setw(4) << bench.Run(benchFrames) << std::endl;
+        mainThreadWake = nullptr;
+        return 0;
+    }
+
+    // Save the config after opening all the scenes
+    config.SaveConfig();
+
     // Create the output display device (LED panel, window, etc)
-    DisplayDevice display;
+    DisplayDevice display(displayBackend, &render);
 
     // Connect display events
     display.OnDisconnect.connect([](){internal_exit = true;});
     if (display.GetInputButton() != nullptr)
     {
-        addButton(*display.GetInputButton());
+        addButton(*display.GetInputButton(), httpService.Commands());
     }
 
+    // Someone wants to see the display, so draw (or blank) it once even if nothing changed
+    display.Frames().SetFrameRequestHandler([&mainWake]()
+    {
+        frameRequested = true;
+        mainWake.Notify();
+    });
+
+    // Serve what the display is showing at /display/snapshot and /display/stream
+    PreviewService previewService(httpService, display);
+
 // Create the button we listen to for sleep commands
 #ifdef LINUX_HID_CONTROLLER_SUPPORT
     UsbButton usbButton;
-    addButton(usbButton);
+    addButton(usbButton, httpService.Commands());
 #endif
-    auto thisFrameComplete = std::chrono::high_resolution_clock::now();
-    auto lastFrameComplete = std::chrono::high_resolution_clock::now();
+    bool wasSleeping = false;
+    int framesToRender = 0;
+
+    // Deep sleep frees the panel refresh thread and GPU resources once we've been asleep
+    // for a while. Waking up before then is instant since nothing has been released yet.
+    // deepSleep itself needs a restart, since the LED panel only keeps the root privileges
+    // it needs to reopen if deep sleep was on when it started.
+    const bool deepSleep = config.GetConfigValue("deepSleep", DEFAULT_DEEP_SLEEP);
+    bool deepSleepSetting = deepSleep;
+    int deepSleepDelaySeconds = DEFAULT_DEEP_SLEEP_DELAY_SECONDS;
+    bool deepSleepReleaseContext = DEFAULT_DEEP_SLEEP_RELEASE_CONTEXT;
+    bool deepAsleep = false;
+    FrameTimePoint sleepStart;
+    config.Subscribe([&](const ConfigUpdateEventArg& arg)
+    {
+        if (arg.UpdateIfChanged("deepSleep", deepSleepSetting, DEFAULT_DEEP_SLEEP) && deepSleepSetting != deepSleep)
+        {
+            fprintf(stderr, "deepSleep changes take effect after a restart.\n");
+        }
+        arg.UpdateIfChanged("deepSleepDelaySeconds", deepSleepDelaySeconds, DEFAULT_DEEP_SLEEP_DELAY_SECONDS);
+        arg.UpdateIfChanged("deepSleepReleaseContext", deepSleepReleaseContext, DEFAULT_DEEP_SLEEP_RELEASE_CONTEXT);
+    });
+
+    // Scene simulation runs on its own thread so it never eats into frame time
+    UpdateLoop updateLoop(baseScenes, overlayScenes);
+    updateLoop.SetWakeSignal(&mainWake);
+    int updateRate = DEFAULT_UPDATE_RATE;
+    config.Subscribe([&](const ConfigUpdateEventArg& arg)
+    {
+        if (arg.UpdateIfChanged("updateRate", updateRate, DEFAULT_UPDATE_RATE))
+        {
+            updateLoop.SetTickRate(updateRate);
+        }
+    });
+    updateLoop.Start();
+
+    // Every thread started so far inherited the main thread's settings, so it only
+    // gets the render thread's now. Report what everything ended up with.
+    ThreadPolicy::Apply("render");
+    {
+        std::stringstream ss;
+        ss << ThreadPolicy::Report();
+        fprintf(stderr, "Thread policies: %s\n", ss.str().c_str());
+    }
+
+    // Block until a command, button, scene update or exit signal needs the main thread.
+    // Displays that can't wake us for their own events get polled instead.
+    auto waitForWake = [&](FrameDuration timeout)
+    {
+        if (display.NeedsEventPolling())
+        {
+            display.ProcessEvents();
+            timeout = std::min<FrameDuration>(timeout, EVENT_POLL_INTERVAL);
+        }
+
+        if (timeout == FrameDuration::max())
+        {
+            mainWake.Wait();
+        }
+        else
+        {
+            mainWake.WaitFor(timeout);
+        }
+    };
+
     // Start the main render loop!
     while (!interrupt_received && !internal_exit)
     {
-        // Update/Draw the map
+        // Apply everything other threads asked for since the last frame.
+        // Commands can touch any scene, so keep the update thread out while they run.
+        if (!httpService.Commands().Empty())
+        {
+            auto lock = updateLoop.LockScenes();
+            httpService.Commands().Drain();
+            updateLoop.WakeAll();
+        }
+
+        updateLoop.SetPaused(sleeping);
+
+        // Draw the map
         if (sleeping)
         {
-            display.Clear();
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            // Blank the display once, then stay idle until something wakes us
+            if (!wasSleeping)
+            {
+                // Clearing publishes a blank frame, which answers any request for one
+                frameRequested = false;
+                display.Clear();
+                wasSleeping = true;
+                sleepStart = FrameClock::now();
+            }
+            else if (frameRequested.exchange(false))
+            {
+                // The panel is dark, whether or not it still has a render context
+                display.Frames().PublishBlank();
+            }
+
+            FrameDuration timeout = FrameDuration::max();
+            if (deepSleep && !deepAsleep)
+            {
+                FrameTimePoint deepSleepTime = sleepStart + std::chrono::seconds(deepSleepDelaySeconds);
+                if (FrameClock::now() >= deepSleepTime)
+                {
+                    // Scenes free their GL resources first while the render context is still around.
+                    // Pausing doesn't wait for an update that's already running, so keep it out.
+                    render.MakeCurrent();
+                    {
+                        auto lock = updateLoop.LockScenes();
+                        for (Scene *scene : baseScenes)
+                        {
+                            scene->ReleaseGL();
+                        }
+                        for (Scene *scene : overlayScenes)
+                        {
+                            scene->ReleaseGL();
+                        }
+                    }
+                    render.Suspend(deepSleepReleaseContext);
+                    display.Suspend();
+                    deepAsleep = true;
+                    fprintf(stderr, "Entered deep sleep.\n");
+                }
+                else
+                {
+                    timeout = deepSleepTime - FrameClock::now();
+                }
+            }
+            waitForWake(timeout);
         }
         else
         {
-            render.BeginDraw();
+            // Don't let the pacer try to account for the time we spent asleep
+            if (wasSleeping)
+            {
+                if (deepAsleep)
+                {
+                    display.Resume();
+                    render.Resume();
+                    deepAsleep = false;
+                }
+                TimeService::ResetFrameTiming();
+                updateLoop.WakeAll();
+                wasSleeping = false;
+            }
 
+            // Only render when a scene has changed. Keep going for the rest of the
+            // pipeline's depth after that, so the last change makes it out to the display.
+            bool redraw = frameRequested.exchange(false);
             for (Scene *scene : baseScenes)
             {
-                scene->Update();
+                redraw = scene->TakeRedrawRequest() || redraw;
             }
 
             for (Scene *scene : overlayScenes)
             {
-                scene->Update();
+                redraw = scene->TakeRedrawRequest() || redraw;
             }
 
-            for (Scene *scene : baseScenes)
+            if (redraw)
             {
-                scene->Draw();
-                if (scene->Visible()) // Only draw one base layer
-                    break;
+                framesToRender = render.GetPipelineDepth();
             }
 
-            for (Scene *scene : overlayScenes)
+            if (framesToRender == 0)
             {
-                scene->Draw();
+                // Nothing to show, so sleep until the update thread changes something
+                waitForWake(FrameDuration::max());
+                TimeService::ResetFrameTiming();
+                continue;
+            }
+            framesToRender--;
+
+            // Everything but the wait for the next frame, which the governor
+            // compares against the frame budget
+            static MetricsPhase& frameMetrics = MetricsService::Phase("render.frame");
+            {
+                MetricsTimer frameTimer(frameMetrics);
+
+                render.BeginDraw();
+
+                for (Scene *scene : baseScenes)
+                {
+                    scene->Draw();
+                    if (scene->Visible()) // Only draw one base layer
+                        break;
+                }
+
+                for (Scene *scene : overlayScenes)
+                {
+                    scene->Draw();
+                }
+
+                render.EndDraw();
+                display.Update(render);
             }
 
-            display.Update();
+            // Step the frame rate and scene quality down if we're struggling to keep up
+            FrameGovernor::Poll();
 
             // Regulate framerate
-            thisFrameComplete = std::chrono::high_resolution_clock::now();
-            std::this_thread::sleep_until(lastFrameComplete + expectedFrameTime);
-            lastFrameComplete = thisFrameComplete;
+            TimeService::FinishAndWaitForNextFrame();
         }
     }
 
+    updateLoop.Stop();
+    mainThreadWake = nullptr;
     config.SaveConfig();
 
     if (interrupt_received)